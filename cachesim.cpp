@@ -0,0 +1,231 @@
+// cachesim library: the C++ (cachesim.h) and C (cachesim_c.h) interfaces
+// over TwoLevelCache.
+#include "cachesim_engine.h"
+#include "cachesim.h"
+#include "cachesim_c.h"
+
+#include <climits>
+#include <stdexcept>
+
+namespace cachesim {
+
+struct Hierarchy::Impl {
+    Config config;
+    TwoLevelCache cache;
+    unsigned int w = 0xABABAB55, z = 0x05080902;    // replacement stream
+    uint64_t accesses = 0, cycles = 0;
+
+    Impl(const Config& c, const HierarchyConfig& hc) : config(c), cache(c.l1_line_size, hc) {}
+};
+
+namespace {
+
+HierarchyConfig toHierarchyConfig(const Config& c) {
+    HierarchyConfig hc;
+    hc.l1_size = c.l1_size;
+    hc.l1_assoc = c.l1_assoc;
+    hc.l1_hit_time = c.l1_hit_time;
+    hc.l2_size = c.l2_size;
+    hc.l2_line_size = c.l2_line_size;
+    hc.l2_assoc = c.l2_assoc;
+    hc.l2_hit_time = c.l2_hit_time;
+    hc.dram_penalty = c.dram_penalty;
+    return hc;
+}
+
+LevelStats levelStats(const Cache& cache) {
+    LevelStats s;
+    s.hits = cache.getHits();
+    s.misses = cache.getMisses();
+    s.accesses = s.hits + s.misses;
+    s.writebacks = cache.getWritebacks();
+    return s;
+}
+
+void checkSpan(size_t size, size_t needed, const char *name) {
+    if (size != 0 && size < needed) throw std::invalid_argument(std::string("cachesim: ") + name + " shorter than addrs");
+}
+
+} // namespace
+
+Hierarchy::Hierarchy(std::unique_ptr<Impl> state) : impl(std::move(state)) {}
+Hierarchy::~Hierarchy() = default;
+
+std::unique_ptr<Hierarchy> Hierarchy::create(const Config& config, std::string *error) {
+    HierarchyConfig hc = toHierarchyConfig(config);
+    std::string reason;
+    bool positive = config.l1_size > 0 && config.l1_assoc > 0 && config.l2_size > 0 && config.l2_assoc > 0 &&
+                    config.l1_hit_time >= 0 && config.l2_hit_time >= 0 && config.dram_penalty >= 0;
+    // line x ways is a set's span; products past INT_MAX would wrap in the
+    // int arithmetic below validate
+    bool fits = (long long)config.l1_line_size * config.l1_assoc <= INT_MAX &&
+                (long long)config.l2_line_size * config.l2_assoc <= INT_MAX;
+    if (!positive) reason = "sizes and ways must be positive, latencies non-negative";
+    else if (!fits) reason = "line size x associativity exceeds the addressable range";
+    else hc.validate({config.l1_line_size}, reason);
+    if (!reason.empty()) {
+        if (error) *error = reason;
+        return nullptr;
+    }
+    return std::unique_ptr<Hierarchy>(new Hierarchy(std::make_unique<Impl>(config, hc)));
+}
+
+uint64_t Hierarchy::access(std::span<const uint64_t> addrs, std::span<const uint8_t> writes, std::span<uint32_t> cycles) {
+    checkSpan(writes.size(), addrs.size(), "writes");
+    checkSpan(cycles.size(), addrs.size(), "cycles");
+    StreamScope stream(impl->w, impl->z);
+    TwoLevelCache& cache = impl->cache;
+    uint64_t total = 0;
+    for (size_t i = 0; i < addrs.size(); i++) {
+        accessType type = !writes.empty() && writes[i] ? WRITE_ACCESS : read_ACCESS;
+        int c = cache.memoryAccess(addrs[i], type);
+        if (!cycles.empty()) cycles[i] = (uint32_t)c;
+        total += c;
+    }
+    impl->accesses += addrs.size();
+    impl->cycles += total;
+    return total;
+}
+
+uint32_t Hierarchy::access(uint64_t addr, bool write) {
+    uint8_t w = write;
+    return (uint32_t)access(std::span<const uint64_t>(&addr, 1), std::span<const uint8_t>(&w, 1));
+}
+
+void Hierarchy::warm(std::span<const uint64_t> addrs, std::span<const uint8_t> writes) {
+    checkSpan(writes.size(), addrs.size(), "writes");
+    StreamScope stream(impl->w, impl->z);
+    for (size_t i = 0; i < addrs.size(); i++) {
+        impl->cache.warmAccess(addrs[i], !writes.empty() && writes[i] ? WRITE_ACCESS : read_ACCESS);
+    }
+}
+
+Stats Hierarchy::stats() const {
+    Stats s;
+    s.l1 = levelStats(*impl->cache.getL1Cache());
+    s.l2 = levelStats(*impl->cache.getL2Cache());
+    s.accesses = impl->accesses;
+    s.cycles = impl->cycles;
+    return s;
+}
+
+const Config& Hierarchy::config() const { return impl->config; }
+
+void Hierarchy::reset() {
+    impl->cache.reset();
+    impl->accesses = impl->cycles = 0;
+}
+
+void Hierarchy::seed(uint64_t seed) {
+    StreamScope stream(impl->w, impl->z);
+    seed_random(seed);
+}
+
+} // namespace cachesim
+
+struct cachesim_hierarchy {
+    std::unique_ptr<cachesim::Hierarchy> hierarchy;
+};
+
+namespace {
+
+cachesim::Config fromC(const cachesim_config& c) {
+    cachesim::Config config;
+    config.l1_size = c.l1_size;
+    config.l1_line_size = c.l1_line_size;
+    config.l1_assoc = c.l1_assoc;
+    config.l1_hit_time = c.l1_hit_time;
+    config.l2_size = c.l2_size;
+    config.l2_line_size = c.l2_line_size;
+    config.l2_assoc = c.l2_assoc;
+    config.l2_hit_time = c.l2_hit_time;
+    config.dram_penalty = c.dram_penalty;
+    return config;
+}
+
+cachesim_level_stats toC(const cachesim::LevelStats& s) {
+    return {s.accesses, s.hits, s.misses, s.writebacks};
+}
+
+// Runs fn and returns `failed` instead of letting an exception cross the
+// C ABI
+template <typename R, typename Fn>
+R guarded(R failed, Fn fn) noexcept {
+    try {
+        return fn();
+    } catch (...) {
+        return failed;
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void cachesim_default_config(cachesim_config *config) {
+    if (!config) return;
+    cachesim::Config d;
+    *config = {d.l1_size, d.l1_line_size, d.l1_assoc, d.l1_hit_time, d.l2_size, d.l2_line_size, d.l2_assoc,
+               d.l2_hit_time, d.dram_penalty};
+}
+
+cachesim_hierarchy *cachesim_create(const cachesim_config *config, char *error, size_t error_size) {
+    std::string reason = "config is NULL";
+    try {
+        auto hierarchy = config ? cachesim::Hierarchy::create(fromC(*config), &reason) : nullptr;
+        if (hierarchy) return new cachesim_hierarchy{std::move(hierarchy)};
+    } catch (const std::exception& e) {
+        reason = e.what();
+    } catch (...) {
+        reason = "unknown error";
+    }
+    if (error && error_size) snprintf(error, error_size, "%s", reason.c_str());
+    return nullptr;
+}
+
+void cachesim_destroy(cachesim_hierarchy *hierarchy) { delete hierarchy; }
+
+uint64_t cachesim_access(cachesim_hierarchy *hierarchy, const uint64_t *addrs, const uint8_t *writes, size_t n,
+                         uint32_t *cycles) {
+    if (!hierarchy || (!addrs && n)) return CACHESIM_ERROR;
+    return guarded<uint64_t>(CACHESIM_ERROR, [&]() {
+        return hierarchy->hierarchy->access(std::span<const uint64_t>(addrs, n),
+                                            std::span<const uint8_t>(writes, writes ? n : 0),
+                                            std::span<uint32_t>(cycles, cycles ? n : 0));
+    });
+}
+
+int cachesim_warm(cachesim_hierarchy *hierarchy, const uint64_t *addrs, const uint8_t *writes, size_t n) {
+    if (!hierarchy || (!addrs && n)) return -1;
+    return guarded(-1, [&]() {
+        hierarchy->hierarchy->warm(std::span<const uint64_t>(addrs, n), std::span<const uint8_t>(writes, writes ? n : 0));
+        return 0;
+    });
+}
+
+int cachesim_get_stats(const cachesim_hierarchy *hierarchy, cachesim_stats *stats) {
+    if (!hierarchy || !stats) return -1;
+    return guarded(-1, [&]() {
+        cachesim::Stats s = hierarchy->hierarchy->stats();
+        *stats = {toC(s.l1), toC(s.l2), s.accesses, s.cycles};
+        return 0;
+    });
+}
+
+int cachesim_reset(cachesim_hierarchy *hierarchy) {
+    if (!hierarchy) return -1;
+    return guarded(-1, [&]() {
+        hierarchy->hierarchy->reset();
+        return 0;
+    });
+}
+
+int cachesim_seed(cachesim_hierarchy *hierarchy, uint64_t seed) {
+    if (!hierarchy) return -1;
+    return guarded(-1, [&]() {
+        hierarchy->hierarchy->seed(seed);
+        return 0;
+    });
+}
+
+} // extern "C"
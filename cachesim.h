@@ -0,0 +1,87 @@
+// cachesim: embeddable two-level cache hierarchy (L1 -> L2 -> DRAM).
+//
+// Address batches are read in place from std::span views, so callers can
+// feed buffers they already own without copying. Each Hierarchy keeps its
+// own random-replacement stream, so several instances (or threads, one
+// instance each) do not perturb one another. A C ABI over the same engine
+// is in cachesim_c.h.
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace cachesim {
+
+inline constexpr int API_VERSION = 1;
+
+// Geometry (bytes) and latencies (cycles); defaults match the simulator
+struct Config {
+    int l1_size = 16 * 1024;
+    int l1_line_size = 64;
+    int l1_assoc = 4;
+    int l1_hit_time = 1;
+    int l2_size = 128 * 1024;
+    int l2_line_size = 64;
+    int l2_assoc = 8;
+    int l2_hit_time = 10;
+    int dram_penalty = 50;
+};
+
+struct LevelStats {
+    uint64_t accesses = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t writebacks = 0;
+
+    double hitRate() const { return accesses ? (double)hits / accesses : 0.0; }
+};
+
+struct Stats {
+    LevelStats l1, l2;
+    uint64_t accesses = 0;      // accesses issued to the hierarchy
+    uint64_t cycles = 0;        // their total latency
+
+    double averageAccessTime() const { return accesses ? (double)cycles / accesses : 0.0; }
+};
+
+class Hierarchy {
+public:
+    // nullptr, with the reason in *error, if the geometry has no whole
+    // number of sets at some level
+    static std::unique_ptr<Hierarchy> create(const Config& config = Config(), std::string *error = nullptr);
+
+    ~Hierarchy();
+    Hierarchy(const Hierarchy&) = delete;
+    Hierarchy& operator=(const Hierarchy&) = delete;
+
+    // Run a batch in order. A non-zero writes[i] makes access i a store;
+    // an empty writes span means all loads. If cycles is not empty it
+    // receives each access' latency. Non-empty writes and cycles spans
+    // must be at least as long as addrs (std::invalid_argument otherwise).
+    // Returns the batch's total cycles.
+    uint64_t access(std::span<const uint64_t> addrs, std::span<const uint8_t> writes = {},
+                    std::span<uint32_t> cycles = {});
+    uint32_t access(uint64_t addr, bool write = false);
+
+    // Functional warmup: contents and replacement state only, no statistics
+    void warm(std::span<const uint64_t> addrs, std::span<const uint8_t> writes = {});
+
+    Stats stats() const;
+    const Config& config() const;
+
+    void reset();                       // empty both levels and the statistics
+    void seed(uint64_t seed);           // restart the replacement stream
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    explicit Hierarchy(std::unique_ptr<Impl> state);
+};
+
+} // namespace cachesim
+
+#endif // CACHESIM_H
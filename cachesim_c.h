@@ -0,0 +1,58 @@
+/* C interface to the cachesim engine: an opaque hierarchy handle fed with
+ * caller-owned address arrays. Mirrors cachesim::Hierarchy in cachesim.h. */
+#ifndef CACHESIM_C_H
+#define CACHESIM_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHESIM_API_VERSION 2
+
+/* Returned by cachesim_access when it fails; no error escapes as a C++
+ * exception. The other calls return 0 on success and -1 on failure. */
+#define CACHESIM_ERROR UINT64_MAX
+
+typedef struct cachesim_hierarchy cachesim_hierarchy;
+
+typedef struct cachesim_config {
+    int l1_size, l1_line_size, l1_assoc, l1_hit_time;
+    int l2_size, l2_line_size, l2_assoc, l2_hit_time;
+    int dram_penalty;
+} cachesim_config;
+
+typedef struct cachesim_level_stats {
+    uint64_t accesses, hits, misses, writebacks;
+} cachesim_level_stats;
+
+typedef struct cachesim_stats {
+    cachesim_level_stats l1, l2;
+    uint64_t accesses, cycles;
+} cachesim_stats;
+
+/* Fill *config with the simulator defaults */
+void cachesim_default_config(cachesim_config *config);
+
+/* NULL on an invalid geometry or failed allocation; the reason is copied to
+ * error (if given) */
+cachesim_hierarchy *cachesim_create(const cachesim_config *config, char *error, size_t error_size);
+void cachesim_destroy(cachesim_hierarchy *hierarchy);
+
+/* Run n accesses; writes (NULL: all loads) marks stores, cycles (may be
+ * NULL) receives each latency. Returns the total cycles, or CACHESIM_ERROR. */
+uint64_t cachesim_access(cachesim_hierarchy *hierarchy, const uint64_t *addrs, const uint8_t *writes, size_t n,
+                         uint32_t *cycles);
+int cachesim_warm(cachesim_hierarchy *hierarchy, const uint64_t *addrs, const uint8_t *writes, size_t n);
+
+int cachesim_get_stats(const cachesim_hierarchy *hierarchy, cachesim_stats *stats);
+int cachesim_reset(cachesim_hierarchy *hierarchy);
+int cachesim_seed(cachesim_hierarchy *hierarchy, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CACHESIM_C_H */
@@ -0,0 +1,2979 @@
+// Simulation engine shared by the cachesim library and the CacheSimulator
+// executable: RNG streams, workload generators, caches and hierarchies,
+// traces and importers, the pipelined, sharded and event-driven paths and
+// the out-of-order core. Header-only; the stable interface for other
+// programs is cachesim.h (C++) and cachesim_c.h (C).
+#ifndef CACHESIM_ENGINE_H
+#define CACHESIM_ENGINE_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <charconv>
+#include <cctype>
+#include <queue>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+#define DRAM_SIZE (64ULL * 1024 * 1024 * 1024)
+#define L1_CACHE_SIZE (16 * 1024)
+#define L2_CACHE_SIZE (128 * 1024)
+#define L1_ASSOCIATIVITY 4
+#define L2_ASSOCIATIVITY 8
+#define L2_LINE_SIZE 64
+#define NO_OF_ITERATIONS 1000000
+
+enum cacheResType { MISS = 0, HIT = 1 };
+enum accessType { read_ACCESS = 0, WRITE_ACCESS = 1 };
+
+// Custom random number generator. State is per thread so that concurrent
+// simulations each own an independent, reproducible stream.
+inline thread_local unsigned int m_w = 0xABABAB55;
+inline thread_local unsigned int m_z = 0x05080902;
+
+// SplitMix64 finalizer, used to derive well-separated seeds
+inline uint64_t mix64(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+inline void seed_random(unsigned long long seed) {
+    uint64_t h = mix64(seed);
+    m_w = (unsigned int)h ^ 0xABABAB55;
+    m_z = (unsigned int)(h >> 32) ^ 0x05080902;
+    if (m_w == 0) m_w = 0xABABAB55;
+    if (m_z == 0) m_z = 0x05080902;
+}
+
+inline unsigned long long time_seed() { return (unsigned long long)time(NULL); }
+
+inline unsigned int rand_() {
+    m_z = 36969 * (m_z & 65535) + (m_z >> 16);
+    m_w = 18000 * (m_w & 65535) + (m_w >> 16);
+    return (m_z << 16) + m_w;
+}
+
+// Swaps a private (w, z) stream into this thread's RNG for the lifetime of
+// the scope and saves where it left off
+class StreamScope {
+private:
+    unsigned int &w, &z, saved_w, saved_z;
+
+public:
+    StreamScope(unsigned int& sw, unsigned int& sz) : w(sw), z(sz), saved_w(m_w), saved_z(m_z) {
+        m_w = w;
+        m_z = z;
+    }
+    ~StreamScope() {
+        w = m_w;
+        z = m_z;
+        m_w = saved_w;
+        m_z = saved_z;
+    }
+};
+
+// Two consecutive draws as one 64-bit value (first draw in the high half)
+inline unsigned long long rand64_() {
+    unsigned long long hi = rand_();
+    return (hi << 32) | rand_();
+}
+
+// Memory generators (state kept at file scope so checkpoints can capture
+// it). Addresses are 64-bit, so memGen1 and memGen3 span all of DRAM_SIZE.
+typedef unsigned long long (*ScalarGenerator)();
+
+inline thread_local unsigned long long gen1_addr = 0;
+inline thread_local unsigned long long gen4_addr = 0;
+inline thread_local unsigned long long gen5_addr = 0;
+
+inline unsigned long long memGen1() { return (gen1_addr++) % DRAM_SIZE; }
+inline unsigned long long memGen2() { return rand_() % (24 * 1024); }
+inline unsigned long long memGen3() { return rand64_() % DRAM_SIZE; }
+inline unsigned long long memGen4() { return (gen4_addr++) % (4 * 1024); }
+inline unsigned long long memGen5() { return (gen5_addr += 32) % (64 * 16 * 1024); }
+
+inline void reset_generators() { gen1_addr = gen4_addr = gen5_addr = 0; }
+
+// Seed this thread's RNG with the stream of one (generator, line size,
+// replicate) point and restart the generators, so every point of a sweep
+// depends only on the master seed and its own coordinates.
+inline unsigned long long derive_seed(unsigned long long master, int generator, int line_size, int replicate) {
+    uint64_t h = mix64(master);
+    h = mix64(h ^ (uint64_t)generator);
+    h = mix64(h ^ (uint64_t)line_size);
+    return mix64(h ^ (uint64_t)replicate);
+}
+
+inline void seed_stream(unsigned long long master, int generator, int line_size, int replicate) {
+    seed_random(derive_seed(master, generator, line_size, replicate));
+    reset_generators();
+}
+
+// Lane-parallel PRNG for bulk generation: LANES independent xoshiro128**
+// streams stored struct-of-arrays, so each step of the lane loop is plain
+// 32-bit vector arithmetic the compiler can turn into SIMD.
+#define RNG_LANES 8
+#define BULK_BLOCK 4096
+
+class LaneRng {
+private:
+    uint32_t s0[RNG_LANES], s1[RNG_LANES], s2[RNG_LANES], s3[RNG_LANES];
+
+    static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+public:
+    explicit LaneRng(unsigned long long seed) {
+        uint64_t h = seed;
+        for (int l = 0; l < RNG_LANES; l++) {
+            uint64_t a = mix64(h++), b = mix64(h++);
+            s0[l] = (uint32_t)a;
+            s1[l] = (uint32_t)(a >> 32);
+            s2[l] = (uint32_t)b;
+            s3[l] = (uint32_t)(b >> 32) | 1;  // never all-zero
+        }
+    }
+
+    // Fill out[0..n) with uniform 32-bit values; n is rounded up to a whole
+    // lane group internally, so out must have room for that.
+    void fill(uint32_t *out, int n) {
+        for (int i = 0; i < n; i += RNG_LANES) {
+            for (int l = 0; l < RNG_LANES; l++) {
+                out[i + l] = rotl(s1[l] * 5, 7) * 9;
+                uint32_t t = s1[l] << 9;
+                s2[l] ^= s0[l];
+                s3[l] ^= s1[l];
+                s1[l] ^= s2[l];
+                s0[l] ^= s3[l];
+                s2[l] ^= t;
+                s3[l] = rotl(s3[l], 11);
+            }
+        }
+    }
+};
+
+// Bulk counterparts of memGen1..5: fill out[0..n) (n <= BULK_BLOCK) with
+// the same address patterns, drawing randomness from a LaneRng.
+typedef void (*BulkGenerator)(unsigned long long *out, int n, LaneRng &rng);
+
+inline void bulkGen1(unsigned long long *out, int n, LaneRng &) {
+    unsigned long long base = gen1_addr;
+    for (int i = 0; i < n; i++) out[i] = (base + i) % DRAM_SIZE;
+    gen1_addr += n;
+}
+inline void bulkGen2(unsigned long long *out, int n, LaneRng &rng) {
+    uint32_t r[BULK_BLOCK];
+    rng.fill(r, n);
+    for (int i = 0; i < n; i++) out[i] = r[i] % (24 * 1024);
+}
+inline void bulkGen3(unsigned long long *out, int n, LaneRng &rng) {
+    uint32_t r[2 * BULK_BLOCK];
+    rng.fill(r, 2 * n);
+    for (int i = 0; i < n; i++) out[i] = (((unsigned long long)r[2 * i] << 32) | r[2 * i + 1]) % DRAM_SIZE;
+}
+inline void bulkGen4(unsigned long long *out, int n, LaneRng &) {
+    unsigned long long base = gen4_addr;
+    for (int i = 0; i < n; i++) out[i] = (base + i) % (4 * 1024);
+    gen4_addr += n;
+}
+inline void bulkGen5(unsigned long long *out, int n, LaneRng &) {
+    unsigned long long base = gen5_addr;
+    for (int i = 0; i < n; i++) out[i] = (base + 32 * (i + 1)) % (64 * 16 * 1024);
+    gen5_addr += 32 * n;
+}
+
+// Workload generators: parameterized address streams that fill blocks like
+// the bulk memGen functions and restart from the beginning on reset().
+class WorkloadGenerator {
+public:
+    virtual ~WorkloadGenerator() = default;
+    virtual string name() const = 0;
+    virtual void reset() = 0;
+    virtual void fill(unsigned long long *out, int n, LaneRng &rng) = 0;
+};
+
+// Adapter so the bulk memGen functions can be used wherever a workload is
+class BulkWorkload : public WorkloadGenerator {
+private:
+    string label;
+    BulkGenerator gen;
+
+public:
+    BulkWorkload(const string& name, BulkGenerator g) : label(name), gen(g) {}
+    string name() const override { return label; }
+    void reset() override { reset_generators(); }
+    void fill(unsigned long long *out, int n, LaneRng &rng) override { gen(out, n, rng); }
+};
+
+// Linked-structure traversal: visits every node of a footprint-sized pool
+// once per lap in a scattered order, touching `fields` consecutive words of
+// each node. The visit order is a bijective hash of a counter over the
+// (power-of-two) node count, so no permutation table is stored.
+class PointerChaseGenerator : public WorkloadGenerator {
+private:
+    unsigned long long base, node_size, num_nodes, mask, counter = 0;
+    int node_bits = 0, fields, field = 0, field_size;
+    unsigned long long node = 0;
+
+    unsigned long long permute(unsigned long long x) const {
+        int half = node_bits / 2 + 1;
+        x = (x * 0x9E3779B97F4A7C15ULL) & mask;
+        x ^= x >> half;
+        x = (x * 0xBF58476D1CE4E5B9ULL) & mask;
+        x ^= x >> half;
+        return x;
+    }
+
+public:
+    PointerChaseGenerator(unsigned long long footprint, unsigned long long nodeSize,
+                          int fieldsPerNode = 1, int fieldSize = 8, unsigned long long baseAddr = 0)
+        : base(baseAddr), node_size(nodeSize), fields(fieldsPerNode), field_size(fieldSize) {
+        num_nodes = 1;
+        while (num_nodes * 2 * node_size <= footprint) { num_nodes *= 2; node_bits++; }
+        mask = num_nodes - 1;
+    }
+
+    string name() const override { return "ptrChase"; }
+    unsigned long long getNumNodes() const { return num_nodes; }
+    void reset() override { counter = 0; field = 0; }
+
+    void fill(unsigned long long *out, int n, LaneRng &) override {
+        for (int i = 0; i < n; i++) {
+            if (field == 0) node = permute(counter++ & mask);
+            out[i] = base + node * node_size + (unsigned long long)field * field_size;
+            if (++field == fields) field = 0;
+        }
+    }
+};
+
+// Blocked GEMM, C[n][n] += A[n][n] * B[n][n] with row-major arrays laid out
+// back to back from base. Tiles are walked ii/jj/kk, and inside a tile each
+// C[i][j] reads A[i][k] and B[k][j] across the k-tile before it is written.
+class TiledMatmulGenerator : public WorkloadGenerator {
+private:
+    unsigned long long n, tile, elem, base_a, base_b, base_c;
+    unsigned long long ii = 0, jj = 0, kk = 0, i = 0, j = 0, k = 0;
+    int step = 0;
+
+    unsigned long long tileEnd(unsigned long long start) const { return min(start + tile, n); }
+
+public:
+    TiledMatmulGenerator(unsigned long long dim, unsigned long long tileSize, unsigned long long elemSize = 8,
+                         unsigned long long baseAddr = 0)
+        : n(dim), tile(tileSize), elem(elemSize), base_a(baseAddr),
+          base_b(baseAddr + dim * dim * elemSize), base_c(baseAddr + 2 * dim * dim * elemSize) {}
+
+    string name() const override { return "gemmTiled"; }
+    unsigned long long getFootprint() const { return 3 * n * n * elem; }
+    void reset() override { ii = jj = kk = i = j = k = 0; step = 0; }
+
+    void fill(unsigned long long *out, int count, LaneRng &) override {
+        for (int idx = 0; idx < count; idx++) {
+            if (step == 0) {
+                out[idx] = base_a + (i * n + k) * elem;
+                step = 1;
+            } else if (step == 1) {
+                out[idx] = base_b + (k * n + j) * elem;
+                step = (++k == tileEnd(kk)) ? 2 : 0;
+            } else {
+                out[idx] = base_c + (i * n + j) * elem;
+                if (++j == tileEnd(jj)) {
+                    j = jj;
+                    if (++i == tileEnd(ii)) {
+                        kk += tile;
+                        if (kk >= n) {
+                            kk = 0;
+                            jj += tile;
+                            if (jj >= n) {
+                                jj = 0;
+                                ii += tile;
+                                if (ii >= n) ii = 0;
+                            }
+                        }
+                        i = ii;
+                        j = jj;
+                    }
+                }
+                k = kk;
+                step = 0;
+            }
+        }
+    }
+};
+
+// Jacobi-style stencil sweep over an nx*ny*nz grid (nz == 1 gives the 2D
+// 5-point stencil, otherwise 7-point). Each interior point reads its
+// neighbourhood from the input grid and writes the output grid.
+class StencilGenerator : public WorkloadGenerator {
+private:
+    unsigned long long nx, ny, nz, elem, base_in, base_out;
+    unsigned long long x = 1, y = 1, z = 0;
+    long long offsets[7];
+    int num_points, point = 0;
+
+public:
+    StencilGenerator(unsigned long long dimX, unsigned long long dimY, unsigned long long dimZ = 1,
+                     unsigned long long elemSize = 8, unsigned long long baseAddr = 0)
+        : nx(dimX), ny(dimY), nz(dimZ), elem(elemSize), base_in(baseAddr),
+          base_out(baseAddr + dimX * dimY * dimZ * elemSize) {
+        // Smaller grids have no interior point and fill() would never wrap
+        if (nx < 3 || ny < 3 || nz == 0 || nz == 2) {
+            throw invalid_argument("StencilGenerator: nx and ny must be >= 3 and nz 1 or >= 3");
+        }
+        long long plane = (long long)(nx * ny);
+        long long deltas[] = {0, -1, 1, -(long long)nx, (long long)nx, -plane, plane};
+        num_points = nz > 1 ? 7 : 5;
+        for (int p = 0; p < num_points; p++) offsets[p] = deltas[p];
+        reset();
+    }
+
+    string name() const override { return nz > 1 ? "stencil3D" : "stencil2D"; }
+    unsigned long long getFootprint() const { return 2 * nx * ny * nz * elem; }
+    void reset() override { x = 1; y = 1; z = nz > 1 ? 1 : 0; point = 0; }
+
+    void fill(unsigned long long *out, int n, LaneRng &) override {
+        for (int i = 0; i < n; i++) {
+            unsigned long long center = (z * ny + y) * nx + x;
+            if (point < num_points) {
+                out[i] = base_in + (unsigned long long)((long long)center + offsets[point]) * elem;
+                point++;
+                continue;
+            }
+            out[i] = base_out + center * elem;
+            point = 0;
+            if (++x == nx - 1) {
+                x = 1;
+                if (++y == ny - 1) {
+                    y = 1;
+                    if (nz > 1 && ++z == nz - 1) z = 1;
+                }
+            }
+        }
+    }
+};
+
+// Open-addressing hash table lookups: each lookup hashes to a uniformly
+// random bucket and linearly probes `probes` consecutive buckets.
+class HashProbeGenerator : public WorkloadGenerator {
+private:
+    unsigned long long num_buckets, bucket_size, base;
+    int probes, probe = 0;
+    unsigned long long bucket = 0;
+
+public:
+    HashProbeGenerator(unsigned long long footprint, unsigned long long bucketSize, int probesPerLookup = 2,
+                       unsigned long long baseAddr = 0)
+        : num_buckets(footprint / bucketSize), bucket_size(bucketSize), base(baseAddr), probes(probesPerLookup) {}
+
+    string name() const override { return "hashProbe"; }
+    void reset() override { probe = 0; }
+
+    // Tables of up to 2^32 buckets scale one 32-bit draw per access; larger
+    // ones take a 64-bit draw modulo the bucket count
+    void fill(unsigned long long *out, int n, LaneRng &rng) override {
+        uint32_t r[2 * BULK_BLOCK];
+        bool wide = num_buckets >> 32;
+        rng.fill(r, wide ? 2 * n : n);
+        for (int i = 0; i < n; i++) {
+            if (probe == 0) {
+                bucket = wide ? (((unsigned long long)r[2 * i] << 32) | r[2 * i + 1]) % num_buckets
+                              : ((unsigned long long)r[i] * num_buckets) >> 32;
+            }
+            out[i] = base + bucket * bucket_size;
+            if (++bucket == num_buckets) bucket = 0;
+            if (++probe == probes) probe = 0;
+        }
+    }
+};
+
+// Uniform double in [0, 1) from two 32-bit draws (53 significant bits)
+inline double unitDouble(uint32_t hi, uint32_t lo) {
+    return (double)(((uint64_t)hi << 21) ^ (lo >> 11)) * (1.0 / 9007199254740992.0);
+}
+
+// Zipf(theta) over the items of a footprint using Hormann-Derflinger
+// rejection-inversion: O(1) expected time and O(1) memory per sample, so
+// footprints up to the full DRAM_SIZE (and beyond) cost nothing to set up.
+// Rank 1 is the hottest item; ranks are scattered over the footprint by a
+// multiplicative bijection unless scatter is disabled.
+class ZipfGenerator : public WorkloadGenerator {
+private:
+    unsigned long long num_items, item_size, base, multiplier = 1;
+    double theta, h_x1, h_n, s_div;
+
+    static double helper1(double x) { return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x)); }
+    static double helper2(double x) { return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x)); }
+    double h(double x) const { return exp(-theta * log(x)); }
+    double hIntegral(double x) const { double lx = log(x); return helper2((1.0 - theta) * lx) * lx; }
+    double hIntegralInverse(double x) const {
+        double t = x * (1.0 - theta);
+        if (t < -1.0) t = -1.0;
+        return exp(helper1(t) * x);
+    }
+
+public:
+    ZipfGenerator(unsigned long long footprint, unsigned long long itemSize, double zipfTheta,
+                  bool scatter = true, unsigned long long baseAddr = 0)
+        : num_items(footprint / itemSize), item_size(itemSize), base(baseAddr), theta(zipfTheta) {
+        h_x1 = hIntegral(1.5) - 1.0;
+        h_n = hIntegral((double)num_items + 0.5);
+        s_div = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+        if (scatter && num_items > 1) {
+            multiplier = 40503;
+            while (gcd(multiplier, num_items) != 1) multiplier += 2;
+        }
+    }
+
+    string name() const override {
+        ostringstream label;
+        label << "zipf" << fixed << setprecision(2) << theta;
+        return label.str();
+    }
+    void reset() override {}
+
+    unsigned long long sampleRank(LaneRng &rng, uint32_t *r) {
+        while (true) {
+            rng.fill(r, 2);
+            double u = h_n + unitDouble(r[0], r[1]) * (h_x1 - h_n);
+            double x = hIntegralInverse(u);
+            double kd = floor(x + 0.5);
+            unsigned long long k = kd < 1.0 ? 1 : (kd > (double)num_items ? num_items : (unsigned long long)kd);
+            if ((double)k - x <= s_div || u >= hIntegral((double)k + 0.5) - h((double)k)) return k;
+        }
+    }
+
+    void fill(unsigned long long *out, int n, LaneRng &rng) override {
+        uint32_t r[RNG_LANES];
+        for (int i = 0; i < n; i++) {
+            unsigned long long rank = sampleRank(rng, r) - 1;
+            out[i] = base + (rank * multiplier % num_items) * item_size;
+        }
+    }
+};
+
+// Walker/Vose alias table: O(1) sampling from a discrete distribution with
+// one column pick and one integer threshold comparison.
+class AliasTable {
+private:
+    vector<uint32_t> threshold;
+    vector<uint32_t> alias;
+
+public:
+    explicit AliasTable(const vector<double>& weights) {
+        size_t n = weights.size();
+        double sum = 0.0;
+        for (double w : weights) sum += w;
+        vector<double> scaled(n);
+        vector<size_t> small, large;
+        for (size_t i = 0; i < n; i++) {
+            scaled[i] = weights[i] * n / sum;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        threshold.assign(n, 0xFFFFFFFFu);
+        alias.resize(n);
+        for (size_t i = 0; i < n; i++) alias[i] = (uint32_t)i;
+        while (!small.empty() && !large.empty()) {
+            size_t s = small.back(), l = large.back();
+            small.pop_back();
+            threshold[s] = (uint32_t)min(4294967295.0, scaled[s] * 4294967296.0);
+            alias[s] = (uint32_t)l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) { large.pop_back(); small.push_back(l); }
+        }
+    }
+
+    size_t size() const { return threshold.size(); }
+
+    uint32_t sample(uint32_t column_draw, uint32_t coin) const {
+        uint32_t column = (uint32_t)(((uint64_t)column_draw * threshold.size()) >> 32);
+        return coin < threshold[column] ? column : alias[column];
+    }
+};
+
+// Mixture of uniform tiers laid out back to back over a footprint, each
+// with its own share of the accesses; the tier is picked through an alias
+// table. Two tiers give the classic hot/cold model.
+class TieredGenerator : public WorkloadGenerator {
+protected:
+    struct Tier {
+        unsigned long long start, items;
+    };
+    vector<Tier> tiers;
+    AliasTable table;
+    unsigned long long item_size, base;
+    string label;
+
+    static vector<double> probabilities(const vector<pair<unsigned long long, double>>& spec) {
+        vector<double> p;
+        for (auto &t : spec) p.push_back(t.second);
+        return p;
+    }
+
+public:
+    // spec: (bytes, access probability) per tier, hottest first
+    TieredGenerator(const vector<pair<unsigned long long, double>>& spec, unsigned long long itemSize,
+                    const string& name = "tiered", unsigned long long baseAddr = 0)
+        : table(probabilities(spec)), item_size(itemSize), base(baseAddr), label(name) {
+        unsigned long long start = 0;
+        for (auto &t : spec) {
+            unsigned long long items = max(1ULL, t.first / itemSize);
+            tiers.push_back({start, items});
+            start += items;
+        }
+    }
+
+    string name() const override { return label; }
+    void reset() override {}
+
+    void fill(unsigned long long *out, int n, LaneRng &rng) override {
+        uint32_t r[4 * BULK_BLOCK];
+        rng.fill(r, 4 * n);
+        for (int i = 0; i < n; i++) {
+            const Tier &t = tiers[table.sample(r[4 * i], r[4 * i + 1])];
+            unsigned long long offset = (((uint64_t)r[4 * i + 2] << 32) | r[4 * i + 3]) % t.items;
+            out[i] = base + (t.start + offset) * item_size;
+        }
+    }
+};
+
+class HotColdGenerator : public TieredGenerator {
+public:
+    HotColdGenerator(unsigned long long footprint, unsigned long long itemSize,
+                     unsigned long long hotBytes, double hotProbability, unsigned long long baseAddr = 0)
+        : TieredGenerator({{hotBytes, hotProbability}, {footprint - hotBytes, 1.0 - hotProbability}},
+                          itemSize, "hotCold", baseAddr) {}
+};
+
+// Instruction-fetch stream: program counters of 4-byte instructions walking
+// a code footprint of fixed-size functions. Each basic block runs 2-10
+// instructions sequentially, then falls through (50%), branches to another
+// block of the same function (35%), or calls a function picked by a Zipf
+// popularity over all functions (15%), so a few hot functions carry most
+// fetches while the cold tail still reaches L2.
+#define CODE_BASE (1ULL << 40)      // above any data footprint
+
+class CodeWalkGenerator : public WorkloadGenerator {
+private:
+    unsigned long long function_size, num_functions;
+    ZipfGenerator functions;
+    unsigned long long pc = CODE_BASE, function_start = CODE_BASE;
+    int block_left = 0;
+
+public:
+    CodeWalkGenerator(unsigned long long footprint, unsigned long long functionSize = 2048, double theta = 0.9)
+        : function_size(checkFunctionSize(functionSize)), num_functions(max(1ULL, footprint / functionSize)),
+          functions(num_functions * functionSize, functionSize, theta, true, CODE_BASE) {}
+
+    // Branch targets are 16-byte slots inside a function
+    static unsigned long long checkFunctionSize(unsigned long long size) {
+        if (size < 16) throw invalid_argument("CodeWalkGenerator: functionSize must be at least 16 bytes");
+        return size;
+    }
+
+    string name() const override { return "codeWalk"; }
+    void reset() override {
+        pc = function_start = CODE_BASE;
+        block_left = 0;
+    }
+
+    void fill(unsigned long long *out, int n, LaneRng &rng) override {
+        uint32_t r[RNG_LANES];
+        for (int i = 0; i < n; i++) {
+            if (block_left == 0) {
+                rng.fill(r, RNG_LANES);
+                block_left = 2 + r[0] % 9;
+                uint32_t branch = r[1] % 100;
+                if (branch >= 85) {
+                    unsigned long long address;
+                    functions.fill(&address, 1, rng);
+                    function_start = pc = address;
+                } else if (branch >= 50) {
+                    pc = function_start + (r[2] % (function_size / 16)) * 16;
+                }
+            }
+            out[i] = pc;
+            pc += 4;
+            if (pc >= function_start + function_size) pc = function_start;
+            block_left--;
+        }
+    }
+};
+
+// Line metadata packed into one word: bit 0 valid, bit 1 dirty, the tag
+// above. Tags are at most 64 - 2 bits for any line of 4 bytes or more, so
+// every geometry fits and a valid line with a given tag compares equal to
+// (tag << LINE_TAG_SHIFT | LINE_VALID) once the dirty bit is masked off.
+#define LINE_VALID 1ULL
+#define LINE_DIRTY 2ULL
+#define LINE_TAG_SHIFT 2
+
+struct CacheLine {
+    uint64_t word = 0;
+
+    bool valid() const { return word & LINE_VALID; }
+    bool dirty() const { return word & LINE_DIRTY; }
+    unsigned long long tag() const { return word >> LINE_TAG_SHIFT; }
+};
+
+// Checkpoint file layout (version 2, packed CacheLine words):
+//   CheckpointHeader | CheckpointCacheHeader x num_caches | line arrays
+// Each line array starts on a CHECKPOINT_ALIGN boundary and is stored in the
+// in-memory CacheLine layout, so a private mapping of the file can be used
+// by the caches directly (copy-on-write) without deserializing anything.
+#define CHECKPOINT_VERSION 3
+#define CHECKPOINT_ALIGN 64
+static const char CHECKPOINT_MAGIC[8] = {'C', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t line_record_size;
+    uint64_t rng_w, rng_z;
+    uint64_t gen_state[3];
+    uint64_t total_accesses, total_cycles, total_stores;
+    int32_t dram_penalty;
+    int32_t num_caches;
+};
+
+struct CheckpointCacheHeader {
+    int32_t cache_size, line_size, associativity, num_sets, hit_time, reserved;
+    uint64_t hits, misses, writebacks, victim_writes;
+    uint64_t lines_offset;
+};
+
+// Read-only view of a whole file, mapped privately where the platform allows
+// so that writes by the simulator never reach the file on disk.
+class MappedFile {
+private:
+    char *base = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    vector<char> fallback;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+#ifndef _WIN32
+        if (mapped) munmap(base, length);
+#endif
+    }
+
+    bool open(const string& path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); return false; }
+        length = (size_t)st.st_size;
+        void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        base = (char*)p;
+        mapped = true;
+        return true;
+#else
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        long n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (n <= 0) { fclose(f); return false; }
+        fallback.resize((size_t)n);
+        bool ok = fread(fallback.data(), 1, fallback.size(), f) == fallback.size();
+        fclose(f);
+        base = fallback.data();
+        length = fallback.size();
+        return ok;
+#endif
+    }
+
+    char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+// Specialized lookup kernels, pre-instantiated for the common geometries
+enum CacheKernel {
+    KERNEL_GENERIC,     // any geometry: division/modulo indexing
+    KERNEL_POW2,        // power-of-two sets, lines and ways; run-time way count
+    KERNEL_POW2_A1, KERNEL_POW2_A2, KERNEL_POW2_A4, KERNEL_POW2_A8, KERNEL_POW2_A16,
+    KERNEL_SECTORED     // lines split into sectors with their own valid/dirty bits
+};
+
+// Sectored lines keep one tag per line and a valid and a dirty bit per
+// sector, in a side array next to the packed line words (sector bit s of
+// the valid mask in the low half, of the dirty mask in the high half).
+// A request covers addr's sector, or every sector of the requesting
+// level's line when it passes that line's size as span. A tag hit with
+// any covered sector invalid is a sector miss: only the missing sectors
+// are filled and nothing is evicted. An evicted line writes back only its
+// dirty sectors.
+#define MAX_SECTORS 16
+
+// getDirtyVictim() when the last miss evicted no dirty line
+#define NO_VICTIM (~0ULL)
+
+inline CacheKernel selectKernel(bool pow2_geometry, int associativity) {
+    if (!pow2_geometry) return KERNEL_GENERIC;
+    switch (associativity) {
+        case 1: return KERNEL_POW2_A1;
+        case 2: return KERNEL_POW2_A2;
+        case 4: return KERNEL_POW2_A4;
+        case 8: return KERNEL_POW2_A8;
+        case 16: return KERNEL_POW2_A16;
+        default: return KERNEL_POW2;
+    }
+}
+
+class Cache {
+private:
+    vector<CacheLine> storage;
+    CacheLine *lines;              // storage.data() or a line array inside a checkpoint
+    shared_ptr<MappedFile> backing;
+    int cache_size, line_size, associativity, num_sets, hit_time;
+    int line_shift = 0, set_shift = 0;
+    unsigned long long set_mask = 0;
+    CacheKernel kernel = KERNEL_GENERIC;
+    bool pow2_geometry = false;
+    int sector_size, sectors = 1, sector_shift = 0;
+    vector<uint32_t> sector_bits;
+    mutable unsigned long long hits = 0;
+    mutable unsigned long long misses = 0;
+    mutable unsigned long long writebacks = 0;
+    // Sectored caches only; whole-line traffic follows from misses and writebacks
+    mutable unsigned long long sector_misses = 0;
+    mutable unsigned long long fill_bytes = 0;
+    mutable unsigned long long writeback_bytes = 0;
+    // Dirty lines written in from the level above (not hits or misses)
+    mutable unsigned long long victim_writes = 0;
+    // Line the last warm() lookup hit or filled (power-of-two, unsectored
+    // geometries); cleared by anything else that can move lines
+    unsigned long long warm_block = ~0ULL;
+    CacheLine *warm_line = nullptr;
+    // Address of the dirty line the last miss evicted, for the next level
+    unsigned long long dirty_victim = NO_VICTIM;
+
+    CacheLine* set(unsigned int index) { return lines + (size_t)index * associativity; }
+    unsigned long long lineAddress(unsigned long long tag, unsigned int set_index) const {
+        return (tag * num_sets + set_index) * line_size;
+    }
+    void locate(unsigned long long addr, unsigned int& set_index, unsigned long long& tag) const {
+        unsigned long long block_addr = pow2_geometry ? addr >> line_shift : addr / line_size;
+        set_index = pow2_geometry ? (unsigned int)(block_addr & set_mask) : (unsigned int)(block_addr % num_sets);
+        tag = pow2_geometry ? block_addr >> set_shift : block_addr / num_sets;
+    }
+
+    // Sectors the requester's span around addr covers, within its line
+    uint32_t sectorMask(unsigned long long addr, int span) const {
+        const long long offset = pow2_geometry ? (long long)(addr & (unsigned long long)(line_size - 1))
+                                               : (long long)(addr % line_size);
+        if (span <= sector_size) return 1u << (int)(offset / sector_size);
+        long long begin = offset - (long long)(addr % span);
+        long long end = min<long long>(begin + span, line_size);
+        int lo = (int)(max(begin, 0LL) / sector_size), hi = (int)((end - 1) / sector_size);
+        return (uint32_t)(((1ULL << (hi + 1)) - 1) & ~((1ULL << lo) - 1));
+    }
+
+public:
+    // sectorSize 0 (or the line size or more) keeps whole lines; otherwise
+    // it must divide the line into at most MAX_SECTORS sectors
+    Cache(int size, int lineSize, int assoc, int hitTime, int sectorSize = 0)
+        : cache_size(size), line_size(lineSize), associativity(assoc), hit_time(hitTime),
+          sector_size(sectorSize > 0 && sectorSize < lineSize ? sectorSize : lineSize) {
+        num_sets = cache_size / (line_size * associativity);
+        pow2_geometry = (line_size & (line_size - 1)) == 0 && (num_sets & (num_sets - 1)) == 0 &&
+                        (associativity & (associativity - 1)) == 0;
+        kernel = selectKernel(pow2_geometry, associativity);
+        while ((1 << line_shift) < line_size) line_shift++;
+        while ((1 << set_shift) < num_sets) set_shift++;
+        set_mask = (unsigned long long)num_sets - 1;
+        storage.resize((size_t)num_sets * associativity);
+        lines = storage.data();
+        if (sector_size < line_size) {
+            sectors = min(MAX_SECTORS, line_size / sector_size);
+            while ((1 << sector_shift) < sector_size) sector_shift++;
+            sector_bits.assign((size_t)num_sets * associativity, 0);
+            kernel = KERNEL_SECTORED;
+        }
+    }
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+
+    int getHitTime() const { return hit_time; }
+    int getCacheSize() const { return cache_size; }
+    int getLineSize() const { return line_size; }
+    int getAssociativity() const { return associativity; }
+    int getNumSets() const { return num_sets; }
+    int getSectorSize() const { return sector_size; }
+    bool isSectored() const { return sectors > 1; }
+
+    unsigned long long getHits() const { return hits; }
+    unsigned long long getMisses() const { return misses; }
+    unsigned long long getWritebacks() const { return writebacks; }
+    unsigned long long getSectorMisses() const { return sector_misses; }
+    unsigned long long getVictimWrites() const { return victim_writes; }
+    // Line a miss that reported a writeback evicted; the caller writes it
+    // into the next level
+    unsigned long long getDirtyVictim() const { return dirty_victim; }
+
+    // Bytes filled from the next level and written back to it
+    unsigned long long getFillBytes() const { return isSectored() ? fill_bytes : misses * line_size; }
+    unsigned long long getWritebackBytes() const { return isSectored() ? writeback_bytes : writebacks * line_size; }
+
+    // Tag and state storage for addresses of addressBits bits: one tag per
+    // line, a valid and a dirty bit per sector
+    unsigned long long metadataBits(int addressBits) const {
+        return (unsigned long long)num_sets * associativity * (addressBits - line_shift - set_shift + 2 * sectors);
+    }
+    double getHitRate() const {
+        unsigned long long total = hits + misses;
+        return total > 0 ? (double)hits / total : 0.0;
+    }
+    void resetStats() { hits = misses = writebacks = sector_misses = fill_bytes = writeback_bytes = victim_writes = 0; }
+
+    // span: bytes the requester moves per fill (its line or sector size);
+    // only sectored caches use it
+    pair<cacheResType, bool> access(unsigned long long addr, accessType type, int span = 0) {
+        warm_block = ~0ULL;
+        return dispatch<true>(addr, type, span);
+    }
+
+    // Write a dirty line (the span's sectors) evicted by the level above.
+    // The data arrives whole, so a missing line is allocated without a
+    // fill, and the write counts as neither hit nor miss. Returns whether
+    // it evicted a dirty line (getDirtyVictim()); DETAILED == false is the
+    // functional warm path.
+    template <bool DETAILED = true>
+    bool install(unsigned long long addr, int span = 0) {
+        warm_block = ~0ULL;
+        unsigned int set_index;
+        unsigned long long tag;
+        locate(addr, set_index, tag);
+        size_t base = (size_t)set_index * associativity;
+        CacheLine *ways = lines + base;
+        const uint64_t match = (tag << LINE_TAG_SHIFT) | LINE_VALID;
+        const uint32_t want = isSectored() ? sectorMask(addr, span) : 0;
+        if (DETAILED) victim_writes++;
+
+        int empty_way = -1;
+        for (int way = 0; way < associativity; way++) {
+            uint64_t word = ways[way].word;
+            if ((word & ~LINE_DIRTY) == match) {
+                ways[way].word = word | LINE_DIRTY;
+                if (isSectored()) sector_bits[base + way] |= want | (want << MAX_SECTORS);
+                return false;
+            }
+            if (!(word & LINE_VALID) && empty_way < 0) empty_way = way;
+        }
+
+        int replace_way = empty_way;
+        bool writeback = false;
+        dirty_victim = NO_VICTIM;
+        if (replace_way < 0) {
+            replace_way = pow2_geometry ? (int)(rand_() & (associativity - 1)) : (int)(rand_() % associativity);
+            writeback = ways[replace_way].dirty();
+            if (writeback) {
+                dirty_victim = lineAddress(ways[replace_way].tag(), set_index);
+                if (DETAILED) {
+                    writebacks++;
+                    if (isSectored()) {
+                        writeback_bytes += (unsigned long long)__builtin_popcount(sector_bits[base + replace_way] >> MAX_SECTORS) * sector_size;
+                    }
+                }
+            }
+        }
+        ways[replace_way].word = match | LINE_DIRTY;
+        if (isSectored()) sector_bits[base + replace_way] = want | (want << MAX_SECTORS);
+        return writeback;
+    }
+
+    // Functional-only access used for warmup: same placement and replacement
+    // (including the rand_() draw on eviction) as access(), but no counters.
+    // Random replacement keeps no recency state, so another access to the
+    // line warmed last is a hit that at most sets its dirty bit, and skips
+    // the lookup.
+    bool warm(unsigned long long addr, accessType type, int span = 0) {
+        if ((addr >> line_shift) == warm_block) {
+            warm_line->word |= type == WRITE_ACCESS ? LINE_DIRTY : 0;
+            return true;
+        }
+        return dispatch<false>(addr, type, span).first == HIT;
+    }
+
+    // Lookup kernel. POW2 geometries index with shift/mask and pick the
+    // victim with a mask; ASSOC > 0 fixes the way count at compile time so
+    // the way scan is fully unrolled. ASSOC == 0 reads it at run time.
+    template <int ASSOC, bool POW2, bool DETAILED>
+    pair<cacheResType, bool> lookup(unsigned long long addr, accessType type) {
+        const int assoc = ASSOC > 0 ? ASSOC : associativity;
+        unsigned long long block_addr, tag;
+        unsigned int set_index;
+        if (POW2) {
+            block_addr = addr >> line_shift;
+            set_index = (unsigned int)(block_addr & set_mask);
+            tag = block_addr >> set_shift;
+        } else {
+            block_addr = addr / line_size;
+            set_index = block_addr % num_sets;
+            tag = block_addr / num_sets;
+        }
+        CacheLine *ways = set(set_index);
+        const uint64_t match = (tag << LINE_TAG_SHIFT) | LINE_VALID;
+        const uint64_t dirty = type == WRITE_ACCESS ? LINE_DIRTY : 0;
+
+        int empty_way = -1;
+        for (int way = 0; way < assoc; way++) {
+            uint64_t word = ways[way].word;
+            if ((word & ~LINE_DIRTY) == match) {
+                if (DETAILED) hits++;
+                if (!DETAILED && POW2) { warm_block = block_addr; warm_line = &ways[way]; }
+                ways[way].word = word | dirty;
+                return {HIT, false};
+            }
+            if (!(word & LINE_VALID) && empty_way < 0) empty_way = way;
+        }
+
+        // Miss: fill the first empty way, otherwise evict a random one
+        if (DETAILED) misses++;
+        int replace_way = empty_way;
+        bool writeback = false;
+        dirty_victim = NO_VICTIM;
+        if (replace_way < 0) {
+            replace_way = POW2 ? (int)(rand_() & (assoc - 1)) : (int)(rand_() % assoc);
+            writeback = ways[replace_way].dirty();
+            if (DETAILED) writebacks += writeback;
+            if (writeback) dirty_victim = lineAddress(ways[replace_way].tag(), set_index);
+        }
+        ways[replace_way].word = match | dirty;
+        if (!DETAILED && POW2) { warm_block = block_addr; warm_line = &ways[replace_way]; }
+        return {MISS, writeback};
+    }
+
+    // Sectored lookup: same placement and replacement as lookup(), plus the
+    // per-sector valid/dirty masks
+    template <bool DETAILED>
+    pair<cacheResType, bool> lookupSectored(unsigned long long addr, accessType type, int span) {
+        unsigned long long block_addr, tag;
+        unsigned int set_index;
+        if (pow2_geometry) {
+            block_addr = addr >> line_shift;
+            set_index = (unsigned int)(block_addr & set_mask);
+            tag = block_addr >> set_shift;
+        } else {
+            block_addr = addr / line_size;
+            set_index = block_addr % num_sets;
+            tag = block_addr / num_sets;
+        }
+        size_t base = (size_t)set_index * associativity;
+        CacheLine *ways = lines + base;
+        uint32_t *bits = sector_bits.data() + base;
+        const uint64_t match = (tag << LINE_TAG_SHIFT) | LINE_VALID;
+        const bool write = type == WRITE_ACCESS;
+        const uint32_t want = sectorMask(addr, span);
+        const uint32_t dirty_bits = want << MAX_SECTORS;
+
+        int empty_way = -1;
+        for (int way = 0; way < associativity; way++) {
+            uint64_t word = ways[way].word;
+            if ((word & ~LINE_DIRTY) == match) {
+                if (write) {
+                    ways[way].word = word | LINE_DIRTY;
+                    bits[way] |= dirty_bits;
+                }
+                uint32_t missing = want & ~bits[way];
+                if (!missing) {
+                    if (DETAILED) hits++;
+                    return {HIT, false};
+                }
+                bits[way] |= missing;
+                if (DETAILED) {
+                    misses++;
+                    sector_misses++;
+                    fill_bytes += (unsigned long long)__builtin_popcount(missing) * sector_size;
+                }
+                return {MISS, false};
+            }
+            if (!(word & LINE_VALID) && empty_way < 0) empty_way = way;
+        }
+
+        if (DETAILED) {
+            misses++;
+            fill_bytes += (unsigned long long)__builtin_popcount(want) * sector_size;
+        }
+        int replace_way = empty_way;
+        bool writeback = false;
+        dirty_victim = NO_VICTIM;
+        if (replace_way < 0) {
+            replace_way = pow2_geometry ? (int)(rand_() & (associativity - 1)) : (int)(rand_() % associativity);
+            writeback = ways[replace_way].dirty();
+            if (writeback) dirty_victim = lineAddress(ways[replace_way].tag(), set_index);
+            if (DETAILED && writeback) {
+                writebacks++;
+                writeback_bytes += (unsigned long long)__builtin_popcount(bits[replace_way] >> MAX_SECTORS) * sector_size;
+            }
+        }
+        ways[replace_way].word = match | (write ? LINE_DIRTY : 0);
+        bits[replace_way] = want | (write ? dirty_bits : 0);
+        return {MISS, writeback};
+    }
+
+    // Kernel selection is fixed at construction, so this switch always
+    // takes the same, perfectly predicted branch
+    template <bool DETAILED>
+    pair<cacheResType, bool> dispatch(unsigned long long addr, accessType type, int span = 0) {
+        switch (kernel) {
+            case KERNEL_SECTORED: return lookupSectored<DETAILED>(addr, type, span);
+            case KERNEL_POW2_A1: return lookup<1, true, DETAILED>(addr, type);
+            case KERNEL_POW2_A2: return lookup<2, true, DETAILED>(addr, type);
+            case KERNEL_POW2_A4: return lookup<4, true, DETAILED>(addr, type);
+            case KERNEL_POW2_A8: return lookup<8, true, DETAILED>(addr, type);
+            case KERNEL_POW2_A16: return lookup<16, true, DETAILED>(addr, type);
+            case KERNEL_POW2: return lookup<0, true, DETAILED>(addr, type);
+            default: return lookup<0, false, DETAILED>(addr, type);
+        }
+    }
+
+    CacheKernel getKernel() const { return kernel; }
+
+    void reset() {
+        size_t n = (size_t)num_sets * associativity;
+        for (size_t i = 0; i < n; i++) lines[i] = {};
+        fill(sector_bits.begin(), sector_bits.end(), 0u);
+        warm_block = ~0ULL;
+        resetStats();
+    }
+
+    // Host memory held by this cache, and the tag bits a line actually
+    // needs for 64-bit addresses (the rest of its word is spare)
+    size_t memoryBytes() const { return sizeof(*this) + lineBytes(); }
+    int getTagBits() const { return 64 - line_shift - set_shift; }
+
+    // Checkpoint support
+    size_t lineBytes() const { return (size_t)num_sets * associativity * sizeof(CacheLine); }
+    const CacheLine* lineData() const { return lines; }
+
+    CheckpointCacheHeader describe() const {
+        CheckpointCacheHeader h = {};
+        h.cache_size = cache_size;
+        h.line_size = line_size;
+        h.associativity = associativity;
+        h.num_sets = num_sets;
+        h.hit_time = hit_time;
+        h.hits = hits;
+        h.misses = misses;
+        h.writebacks = writebacks;
+        h.victim_writes = victim_writes;
+        return h;
+    }
+
+    // Sector masks are not part of the checkpoint format
+    bool matches(const CheckpointCacheHeader& h) const {
+        return !isSectored() && h.cache_size == cache_size && h.line_size == line_size &&
+               h.associativity == associativity && h.num_sets == num_sets;
+    }
+
+    // Switch to a line array owned by a mapped checkpoint. No lines are copied;
+    // the mapping is private, so later updates only touch this process' pages.
+    void attach(const CheckpointCacheHeader& h, CacheLine *mapped_lines, shared_ptr<MappedFile> file) {
+        backing = std::move(file);
+        lines = mapped_lines;
+        warm_block = ~0ULL;
+        storage.clear();
+        storage.shrink_to_fit();
+        hit_time = h.hit_time;
+        hits = h.hits;
+        misses = h.misses;
+        writebacks = h.writebacks;
+        victim_writes = h.victim_writes;
+    }
+};
+
+// Run-time hierarchy parameters. Defaults are the compiled-in geometry;
+// the L1 line size is swept separately by the drivers.
+#define L1I_LINE_SIZE 64
+
+struct HierarchyConfig {
+    int l1_size = L1_CACHE_SIZE;
+    int l1_assoc = L1_ASSOCIATIVITY;
+    int l1_hit_time = 1;
+    int l2_size = L2_CACHE_SIZE;
+    int l2_line_size = L2_LINE_SIZE;
+    int l2_assoc = L2_ASSOCIATIVITY;
+    int l2_hit_time = 10;
+    int dram_penalty = 50;
+    unsigned long long iterations = NO_OF_ITERATIONS;
+    unsigned long long warmup = 0;      // functional-only instructions (trace records) before measuring
+    double mem_ratio = 0.35;
+    int l1_sector_size = 0;             // 0: unsectored lines
+    int l2_sector_size = 0;
+    int l1i_size = L1_CACHE_SIZE;       // instruction cache (--ifetch)
+    int l1i_assoc = L1_ASSOCIATIVITY;
+    // Out-of-order core (--ooo)
+    int rob_size = 128;
+    int issue_width = 4;
+    int lsq_size = 48;
+    double load_dependency = 0.25;      // chance a load waits for the previous load
+    // Link bandwidth in GB/s at clock_ghz (0: unlimited)
+    double clock_ghz = 3.0;
+    double l2_bandwidth = 0;            // L1 <-> L2
+    double dram_bandwidth = 0;          // L2 <-> DRAM
+
+    // Integer form of the memory-instruction test used by the block paths:
+    // rand_() <= memThreshold()  <=>  rand_() / 0xFFFFFFFF <= mem_ratio
+    uint32_t memThreshold() const { return (uint32_t)(mem_ratio * 0xFFFFFFFFu); }
+
+    // Set one "key = value" parameter; false for an unknown key or bad value
+    bool set(const string& key, const string& value) {
+        char *end = nullptr;
+        double v = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || v < 0) return false;
+        if (key == "mem_ratio") { mem_ratio = v; return v <= 1.0; }
+        if (key == "load_dependency") { load_dependency = v; return v <= 1.0; }
+        if (key == "clock_ghz") { clock_ghz = v; return v > 0; }
+        if (key == "l2_bandwidth") { l2_bandwidth = v; return true; }
+        if (key == "dram_bandwidth") { dram_bandwidth = v; return true; }
+        if (v != floor(v) || v > 1e15) return false;
+        if (key == "warmup") { warmup = (unsigned long long)v; return true; }
+        if (v < 1) return false;
+        if (key == "iterations") { iterations = (unsigned long long)v; return true; }
+        if (v > 1 << 30) return false;
+        int *fields[] = {&l1_size, &l1_assoc, &l1_hit_time, &l2_size, &l2_line_size, &l2_assoc, &l2_hit_time, &dram_penalty,
+                         &rob_size, &issue_width, &lsq_size, &l1i_size, &l1i_assoc, &l1_sector_size, &l2_sector_size};
+        const char *names[] = {"l1_size", "l1_assoc", "l1_hit_time", "l2_size", "l2_line_size", "l2_assoc", "l2_hit_time", "dram_penalty",
+                               "rob_size", "issue_width", "lsq_size", "l1i_size", "l1i_assoc", "l1_sector_size", "l2_sector_size"};
+        for (int i = 0; i < 15; i++) {
+            if (key == names[i]) { *fields[i] = (int)v; return true; }
+        }
+        return false;
+    }
+
+    // "key=value" form used on the command line
+    bool set(const string& assignment) {
+        size_t eq = assignment.find('=');
+        return eq != string::npos && set(assignment.substr(0, eq), assignment.substr(eq + 1));
+    }
+
+    // Config file: one "key = value" per line, '#' starts a comment
+    bool load(const string& path, string& error) {
+        FILE *f = fopen(path.c_str(), "r");
+        if (!f) { error = "cannot open " + path; return false; }
+        char buf[256];
+        int line = 0;
+        bool ok = true;
+        while (ok && fgets(buf, sizeof(buf), f)) {
+            line++;
+            string text = buf;
+            text = text.substr(0, text.find('#'));
+            text.erase(remove_if(text.begin(), text.end(), [](char c) { return isspace((unsigned char)c); }), text.end());
+            if (text.empty()) continue;
+            ok = set(text);
+            if (!ok) error = path + ":" + to_string(line) + ": bad setting '" + text + "'";
+        }
+        fclose(f);
+        return ok;
+    }
+
+    // Every level needs a whole number of sets for each swept L1 line size,
+    // and lines of at least 4 bytes so tags fit a packed CacheLine
+    bool validate(const vector<int>& l1_line_sizes, string& error) const {
+        // Products in 64 bits: line x assoc can overflow int
+        auto wholeSets = [](int size, int line, int assoc) {
+            long long set_bytes = (long long)line * assoc;
+            return set_bytes <= size && size % set_bytes == 0;
+        };
+        for (int line : l1_line_sizes) {
+            if (line < 4) {
+                error = "L1 lines must be at least 4 bytes";
+                return false;
+            }
+            if (!wholeSets(l1_size, line, l1_assoc)) {
+                error = "l1_size must be a multiple of " + to_string(line) + "B lines x l1_assoc";
+                return false;
+            }
+        }
+        if (!wholeSets(l1i_size, L1I_LINE_SIZE, l1i_assoc)) {
+            error = "l1i_size must be a multiple of " + to_string(L1I_LINE_SIZE) + "B lines x l1i_assoc";
+            return false;
+        }
+        if (l2_line_size < 4 || !wholeSets(l2_size, l2_line_size, l2_assoc)) {
+            error = "l2_size must be a multiple of l2_line_size x l2_assoc (lines >= 4 bytes)";
+            return false;
+        }
+        // Sectors must split each (longer) line into at most MAX_SECTORS
+        auto sectorsFit = [](int sector, int line) {
+            return sector == 0 || sector >= line || (line % sector == 0 && line / sector <= MAX_SECTORS);
+        };
+        for (int line : l1_line_sizes) {
+            if (!sectorsFit(l1_sector_size, line)) {
+                error = "l1_sector_size must divide " + to_string(line) + "B lines into at most " + to_string(MAX_SECTORS) + " sectors";
+                return false;
+            }
+        }
+        if (!sectorsFit(l2_sector_size, l2_line_size)) {
+            error = "l2_sector_size must divide l2_line_size into at most " + to_string(MAX_SECTORS) + " sectors";
+            return false;
+        }
+        return true;
+    }
+
+    // Sizes in KB when they are whole KB, otherwise in bytes
+    static string sizeText(int bytes) {
+        return bytes % 1024 == 0 ? to_string(bytes >> 10) + "KB" : to_string(bytes) + "B";
+    }
+
+    void print(ostream& out) const {
+        out << "L1 " << sizeText(l1_size) << " " << l1_assoc << "-way " << l1_hit_time << "cy, L2 "
+            << sizeText(l2_size) << " " << l2_assoc << "-way " << l2_line_size << "B " << l2_hit_time
+            << "cy, DRAM " << dram_penalty << "cy";
+        if (l1_sector_size) out << ", L1 sectors " << l1_sector_size << "B";
+        if (l2_sector_size && l2_sector_size < l2_line_size) out << ", L2 sectors " << l2_sector_size << "B";
+        if (l2_bandwidth > 0) out << ", L2 link " << l2_bandwidth << "GB/s";
+        if (dram_bandwidth > 0) out << ", DRAM link " << dram_bandwidth << "GB/s";
+        if (l2_bandwidth > 0 || dram_bandwidth > 0) out << " at " << clock_ghz << "GHz";
+    }
+};
+
+// A link between two levels with a bandwidth limit. Its utilization is
+// measured over epochs of LINK_EPOCH cycles on the hierarchy's clock and
+// smoothed, and each transfer waits the M/D/1 mean queueing delay,
+// rho / (2 (1 - rho)) times its own service time, so latency climbs as
+// the link nears saturation (rho is capped at LINK_MAX_UTILIZATION).
+#define LINK_EPOCH 4096
+#define LINK_MAX_UTILIZATION 0.95
+
+class BandwidthLink {
+private:
+    double bytes_per_cycle = 0;         // 0: unlimited, no queueing
+    double rho = 0;
+    double busy_cycles = 0;
+    unsigned long long epoch_start = 0, epoch_bytes = 0;
+    unsigned long long wait_cycles = 0, transfers = 0;
+
+public:
+    BandwidthLink(double gb_per_s = 0, double clock_ghz = 1) : bytes_per_cycle(gb_per_s / clock_ghz) {}
+
+    bool isLimited() const { return bytes_per_cycle > 0; }
+    double getBusyCycles() const { return busy_cycles; }
+    unsigned long long getWaitCycles() const { return wait_cycles; }
+    unsigned long long getTransfers() const { return transfers; }
+
+    // Queueing delay for moving bytes at cycle now
+    int transfer(unsigned long long bytes, unsigned long long now) {
+        if (now - epoch_start >= LINK_EPOCH) {
+            double measured = epoch_bytes / ((now - epoch_start) * bytes_per_cycle);
+            rho = min(0.5 * (rho + measured), LINK_MAX_UTILIZATION);
+            epoch_start = now;
+            epoch_bytes = 0;
+        }
+        epoch_bytes += bytes;
+        transfers++;
+        double service = bytes / bytes_per_cycle;
+        busy_cycles += service;
+        int wait = (int)(service * rho / (2 * (1 - rho)) + 0.5);
+        wait_cycles += wait;
+        return wait;
+    }
+
+    void reset() {
+        rho = busy_cycles = 0;
+        epoch_start = epoch_bytes = wait_cycles = transfers = 0;
+    }
+};
+
+class TwoLevelCache {
+private:
+    Cache *l1_cache, *l2_cache;
+    int dram_penalty;
+    mutable unsigned long long total_accesses = 0;
+    mutable unsigned long long total_cycles = 0;
+    unsigned long long total_stores = 0;
+    // Bandwidth model: the clock is the memory cycles plus the non-memory
+    // cycles the driver reports through advance()
+    BandwidthLink l2_link, dram_link;
+    unsigned long long other_cycles = 0;
+    unsigned long long l1_bytes_seen = 0, l2_bytes_seen = 0;
+
+    // Delay for the bytes the level has moved since the last call
+    int linkDelay(BandwidthLink& link, const Cache *level, unsigned long long& seen) {
+        unsigned long long moved = level->getFillBytes() + level->getWritebackBytes();
+        unsigned long long bytes = moved - seen;
+        seen = moved;
+        return link.transfer(bytes, total_cycles + other_cycles);
+    }
+
+public:
+    TwoLevelCache(int l1_line_size, const HierarchyConfig& config = HierarchyConfig())
+        : dram_penalty(config.dram_penalty), l2_link(config.l2_bandwidth, config.clock_ghz),
+          dram_link(config.dram_bandwidth, config.clock_ghz) {
+        l1_cache = new Cache(config.l1_size, l1_line_size, config.l1_assoc, config.l1_hit_time, config.l1_sector_size);
+        l2_cache = new Cache(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time, config.l2_sector_size);
+    }
+    ~TwoLevelCache() { delete l1_cache; delete l2_cache; }
+
+    void reset() {
+        l1_cache->reset();
+        l2_cache->reset();
+        total_accesses = total_cycles = total_stores = 0;
+        l2_link.reset();
+        dram_link.reset();
+        other_cycles = l1_bytes_seen = l2_bytes_seen = 0;
+    }
+
+    Cache* getL1Cache() const { return l1_cache; }
+    Cache* getL2Cache() const { return l2_cache; }
+    unsigned long long getStores() const { return total_stores; }
+    const BandwidthLink& getL2Link() const { return l2_link; }
+    const BandwidthLink& getDramLink() const { return dram_link; }
+
+    // Non-memory cycles that pass between accesses, for link utilization
+    void advance(unsigned long long cycles) { other_cycles += cycles; }
+    unsigned long long getElapsedCycles() const { return total_cycles + other_cycles; }
+
+    // Fraction of the elapsed cycles a limited link spent transferring
+    double linkUtilization(const BandwidthLink& link) const {
+        unsigned long long elapsed = getElapsedCycles();
+        return elapsed ? link.getBusyCycles() / elapsed : 0.0;
+    }
+    size_t memoryBytes() const { return sizeof(*this) + l1_cache->memoryBytes() + l2_cache->memoryBytes(); }
+
+    double getAverageAccessTime() const {
+        return total_accesses > 0 ? (double)total_cycles / total_accesses : 0.0;
+    }
+
+    // Write tags, valid/dirty bits, counters, RNG and generator state to a
+    // versioned checkpoint that restoreCheckpoint() can map back in place.
+    // Hierarchies with sectored levels cannot be checkpointed.
+    bool saveCheckpoint(const string& path) const {
+        if (l1_cache->isSectored() || l2_cache->isSectored()) return false;
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+
+        const Cache *levels[] = {l1_cache, l2_cache};
+        CheckpointHeader header = {};
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.line_record_size = sizeof(CacheLine);
+        header.rng_w = m_w;
+        header.rng_z = m_z;
+        header.gen_state[0] = gen1_addr;
+        header.gen_state[1] = gen4_addr;
+        header.gen_state[2] = gen5_addr;
+        header.total_accesses = total_accesses;
+        header.total_cycles = total_cycles;
+        header.total_stores = total_stores;
+        header.dram_penalty = dram_penalty;
+        header.num_caches = 2;
+
+        CheckpointCacheHeader cache_headers[2];
+        uint64_t offset = sizeof(header) + sizeof(cache_headers);
+        for (int i = 0; i < 2; i++) {
+            offset = (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+            cache_headers[i] = levels[i]->describe();
+            cache_headers[i].lines_offset = offset;
+            offset += levels[i]->lineBytes();
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                  fwrite(cache_headers, sizeof(cache_headers), 1, f) == 1;
+        uint64_t written = sizeof(header) + sizeof(cache_headers);
+        static const char zeros[CHECKPOINT_ALIGN] = {};
+        for (int i = 0; i < 2 && ok; i++) {
+            size_t pad = (size_t)(cache_headers[i].lines_offset - written);
+            ok = (pad == 0 || fwrite(zeros, 1, pad, f) == pad) &&
+                 fwrite(levels[i]->lineData(), 1, levels[i]->lineBytes(), f) == levels[i]->lineBytes();
+            written = cache_headers[i].lines_offset + levels[i]->lineBytes();
+        }
+        return (fclose(f) == 0) && ok;
+    }
+
+    // Restore a checkpoint written by a hierarchy with the same geometry.
+    // Both levels use the mapped line arrays directly; nothing is changed if
+    // the file is missing, truncated, from another version or geometry.
+    bool restoreCheckpoint(const string& path) {
+        auto file = make_shared<MappedFile>();
+        if (!file->open(path)) return false;
+
+        const CheckpointHeader *header = (const CheckpointHeader*)file->data();
+        if (file->size() < sizeof(CheckpointHeader) + 2 * sizeof(CheckpointCacheHeader) ||
+            memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != CHECKPOINT_VERSION ||
+            header->line_record_size != sizeof(CacheLine) ||
+            header->num_caches != 2) {
+            return false;
+        }
+
+        const CheckpointCacheHeader *cache_headers = (const CheckpointCacheHeader*)(header + 1);
+        Cache *levels[] = {l1_cache, l2_cache};
+        for (int i = 0; i < 2; i++) {
+            const CheckpointCacheHeader &h = cache_headers[i];
+            if (!levels[i]->matches(h) || h.lines_offset % CHECKPOINT_ALIGN != 0 ||
+                h.lines_offset + levels[i]->lineBytes() > file->size()) {
+                return false;
+            }
+        }
+
+        for (int i = 0; i < 2; i++) {
+            levels[i]->attach(cache_headers[i], (CacheLine*)(file->data() + cache_headers[i].lines_offset), file);
+        }
+        m_w = (unsigned int)header->rng_w;
+        m_z = (unsigned int)header->rng_z;
+        gen1_addr = header->gen_state[0];
+        gen4_addr = header->gen_state[1];
+        gen5_addr = header->gen_state[2];
+        total_accesses = header->total_accesses;
+        total_cycles = header->total_cycles;
+        total_stores = header->total_stores;
+        dram_penalty = header->dram_penalty;
+        // The links only see traffic moved after the restore
+        l1_bytes_seen = l1_cache->getFillBytes() + l1_cache->getWritebackBytes();
+        l2_bytes_seen = l2_cache->getFillBytes() + l2_cache->getWritebackBytes();
+        return true;
+    }
+
+    // Warmup path: updates tags, dirty bits and replacement state of both
+    // levels exactly like memoryAccess(), without cycles or statistics.
+    void warmAccess(unsigned long long addr, accessType type) {
+        if (l1_cache->warm(addr, type)) return;
+        unsigned long long victim = l1_cache->getDirtyVictim();
+        if (victim != NO_VICTIM) l2_cache->install<false>(victim, l1_cache->getLineSize());
+        l2_cache->warm(addr, read_ACCESS, l1_cache->getSectorSize());
+    }
+
+    int memoryAccess(unsigned long long addr, accessType type) {
+        total_accesses++;
+        total_stores += type == WRITE_ACCESS;
+        int cycles = 0;
+
+        // Always pay L1 access time
+        cycles += l1_cache->getHitTime();
+        auto l1_result = l1_cache->access(addr, type);
+
+        if (l1_result.first == HIT) {
+            total_cycles += cycles;
+            return cycles;
+        }
+
+        // L1 miss - install the dirty victim in L2. A dirty line that this
+        // evicts from L2 adds DRAM traffic but no latency.
+        if (l1_result.second) {
+            cycles += l2_cache->getHitTime();
+            l2_cache->install(l1_cache->getDirtyVictim(), l1_cache->getLineSize());
+        }
+
+        // Access L2
+        cycles += l2_cache->getHitTime();
+        // L2 supplies everything the L1 fill moves: the line, or its sector
+        auto l2_result = l2_cache->access(addr, read_ACCESS, l1_cache->getSectorSize());
+        if (l2_link.isLimited()) cycles += linkDelay(l2_link, l1_cache, l1_bytes_seen);
+
+        if (l2_result.first == HIT) {
+            total_cycles += cycles;
+            return cycles;
+        }
+
+        // L2 miss - access DRAM
+        cycles += dram_penalty;
+
+        // Handle L2 writeback if needed
+        if (l2_result.second) {
+            cycles += dram_penalty;
+        }
+        if (dram_link.isLimited()) cycles += linkDelay(dram_link, l2_cache, l2_bytes_seen);
+
+        total_cycles += cycles;
+        return cycles;
+    }
+};
+
+// Energy of one cache geometry: per-event dynamic energy (pJ) for a line
+// read, a line write and a tag lookup, and leakage power (mW)
+struct CacheEnergy {
+    int size, assoc, line;
+    double read, write, tag, leakage;
+};
+
+// DRAM: one activate per line transfer, read/write energy per 64B burst
+struct DramEnergy {
+    double activate = 1800, read = 1200, write = 1300;
+};
+
+// Energy of a run in pJ; leakage covers both cache levels
+struct EnergyBreakdown {
+    double l1 = 0, l2 = 0, dram = 0, leakage = 0;
+    double total() const { return l1 + l2 + dram + leakage; }
+};
+
+// Cache energies from a table keyed by size, associativity and line size.
+// A geometry without an entry is scaled from the nearest one (in log2
+// distance): line energies with line size and the square root of the
+// capacity, tag energy with the ways and the square root of the capacity,
+// leakage with the capacity. The built-in table holds rough 22nm figures;
+// load() replaces it with "cache SIZE ASSOC LINE READ WRITE TAG LEAKAGE"
+// and "dram ACTIVATE READ WRITE" lines.
+class EnergyModel {
+private:
+    vector<CacheEnergy> table = {
+        {8 * 1024, 2, 64, 6.0, 6.8, 0.8, 2.0},
+        {16 * 1024, 4, 64, 8.0, 9.0, 1.5, 4.0},
+        {32 * 1024, 8, 64, 11.0, 12.5, 2.6, 8.0},
+        {128 * 1024, 8, 64, 25.0, 28.0, 4.0, 30.0},
+        {256 * 1024, 8, 64, 32.0, 36.0, 5.0, 55.0},
+        {1024 * 1024, 16, 64, 60.0, 66.0, 9.0, 200.0},
+    };
+    DramEnergy dram;
+
+    // Dynamic energy of one level: a lookup per access or victim install, a
+    // line read or write per access, and line writes/reads for the bytes
+    // filled/written back
+    static double levelEnergy(const Cache& c, const CacheEnergy& e, unsigned long long reads, unsigned long long writes) {
+        double lines_filled = (double)c.getFillBytes() / c.getLineSize();
+        double lines_out = (double)c.getWritebackBytes() / c.getLineSize();
+        return (double)(c.getHits() + c.getMisses() + c.getVictimWrites()) * e.tag + reads * e.read + writes * e.write +
+               lines_filled * e.write + lines_out * e.read;
+    }
+
+public:
+    const DramEnergy& getDram() const { return dram; }
+
+    CacheEnergy lookup(int size, int assoc, int line) const {
+        const CacheEnergy *best = &table[0];
+        double best_distance = 1e300;
+        for (const CacheEnergy& e : table) {
+            double d = fabs(log2((double)size / e.size)) + fabs(log2((double)assoc / e.assoc)) +
+                       fabs(log2((double)line / e.line));
+            if (d < best_distance) { best_distance = d; best = &e; }
+        }
+        double capacity = (double)size / best->size, width = (double)line / best->line;
+        double s = sqrt(capacity);
+        return {size, assoc, line, best->read * s * width, best->write * s * width,
+                best->tag * s * assoc / best->assoc, best->leakage * capacity};
+    }
+
+    bool load(const string& path, string& error) {
+        FILE *f = fopen(path.c_str(), "r");
+        if (!f) { error = "cannot open " + path; return false; }
+        vector<CacheEnergy> loaded;
+        DramEnergy d = dram;
+        char buf[256];
+        int line = 0;
+        bool ok = true;
+        while (ok && fgets(buf, sizeof(buf), f)) {
+            line++;
+            string text = buf;
+            istringstream in(text.substr(0, text.find('#')));
+            string kind;
+            if (!(in >> kind)) continue;
+            CacheEnergy e;
+            if (kind == "cache") {
+                ok = (in >> e.size >> e.assoc >> e.line >> e.read >> e.write >> e.tag >> e.leakage) &&
+                     e.size > 0 && e.assoc > 0 && e.line > 0;
+                if (ok) loaded.push_back(e);
+            } else if (kind == "dram") {
+                ok = (bool)(in >> d.activate >> d.read >> d.write);
+            } else {
+                ok = false;
+            }
+            if (!ok) error = path + ":" + to_string(line) + ": bad entry";
+        }
+        fclose(f);
+        if (!ok) return false;
+        if (!loaded.empty()) table = loaded;
+        dram = d;
+        return true;
+    }
+
+    // Energy of everything the hierarchy counted since its last reset;
+    // leakage runs for its elapsed cycles at clock_ghz
+    EnergyBreakdown measure(const TwoLevelCache& cache, double clock_ghz) const {
+        const Cache &l1 = *cache.getL1Cache(), &l2 = *cache.getL2Cache();
+        CacheEnergy e1 = lookup(l1.getCacheSize(), l1.getAssociativity(), l1.getLineSize());
+        CacheEnergy e2 = lookup(l2.getCacheSize(), l2.getAssociativity(), l2.getLineSize());
+        unsigned long long stores = cache.getStores();
+        EnergyBreakdown out;
+        // L2 reads are the L1 misses; L1's dirty victims are installed as L2
+        // writes and never reach DRAM unless L2 evicts them later
+        out.l1 = levelEnergy(l1, e1, l1.getHits() + l1.getMisses() - stores, stores);
+        out.l2 = levelEnergy(l2, e2, l2.getHits() + l2.getMisses(), l2.getVictimWrites());
+        out.dram = (double)(l2.getMisses() + l2.getWritebacks()) * dram.activate +
+                   (double)l2.getFillBytes() / 64 * dram.read + (double)l2.getWritebackBytes() / 64 * dram.write;
+        out.leakage = (e1.leakage + e2.leakage) * cache.getElapsedCycles() / clock_ghz;     // mW x ns = pJ
+        return out;
+    }
+};
+
+// Split first level: an L1I and an L1D over one shared L2. Two shadow L2s
+// of the same geometry see only the instruction or only the data misses,
+// so each side's extra misses in the shared L2 measure how much the other
+// side interferes with it. Fetches reuse the current line without a
+// lookup; an L1I miss stalls fetch for the L2 (and DRAM) time.
+
+class SplitL1Hierarchy {
+private:
+    Cache l1i, l1d, l2, l2_inst_alone, l2_data_alone;
+    int dram_penalty;
+    unsigned long long fetch_line = ~0ULL;
+    int fetch_shift;
+    // The shadow L2s draw victims from their own streams, so they leave
+    // the shared L2's sequence of draws untouched
+    unsigned int inst_w, inst_z, data_w, data_z;
+    // Demand misses of the shadow L2s
+    unsigned long long inst_alone_misses = 0, data_alone_misses = 0;
+
+    bool shadowAccess(Cache& shadow, unsigned int& w, unsigned int& z, unsigned long long addr) {
+        StreamScope stream(w, z);
+        return shadow.access(addr, read_ACCESS).first == HIT;
+    }
+    void shadowInstall(Cache& shadow, unsigned int& w, unsigned int& z, unsigned long long addr) {
+        StreamScope stream(w, z);
+        shadow.install(addr);
+    }
+
+public:
+    unsigned long long fetch_lookups = 0, l2_inst_misses = 0, l2_data_misses = 0;
+
+    SplitL1Hierarchy(int l1d_line_size, const HierarchyConfig& config = HierarchyConfig())
+        : l1i(config.l1i_size, L1I_LINE_SIZE, config.l1i_assoc, config.l1_hit_time),
+          l1d(config.l1_size, l1d_line_size, config.l1_assoc, config.l1_hit_time),
+          l2(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time),
+          l2_inst_alone(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time),
+          l2_data_alone(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time),
+          dram_penalty(config.dram_penalty), fetch_shift(__builtin_ctz(L1I_LINE_SIZE)) {
+        uint64_t inst = mix64(((uint64_t)m_z << 32) | m_w), data = mix64(inst);
+        inst_w = (unsigned int)inst | 1;
+        inst_z = (unsigned int)(inst >> 32) | 1;
+        data_w = (unsigned int)data | 1;
+        data_z = (unsigned int)(data >> 32) | 1;
+    }
+
+    Cache& getL1ICache() { return l1i; }
+    Cache& getL1DCache() { return l1d; }
+    Cache& getL2Cache() { return l2; }
+    unsigned long long getL2InstMissesAlone() const { return inst_alone_misses; }
+    unsigned long long getL2DataMissesAlone() const { return data_alone_misses; }
+
+    // Extra stall cycles for fetching the instruction at pc
+    int fetch(unsigned long long pc) {
+        unsigned long long line = pc >> fetch_shift;
+        if (line == fetch_line) return 0;
+        fetch_line = line;
+        fetch_lookups++;
+        if (l1i.access(pc, read_ACCESS).first == HIT) return 0;
+        inst_alone_misses += !shadowAccess(l2_inst_alone, inst_w, inst_z, pc);
+        auto l2_result = l2.access(pc, read_ACCESS);
+        if (l2_result.first == HIT) return l2.getHitTime();
+        l2_inst_misses++;
+        return l2.getHitTime() + dram_penalty * (l2_result.second ? 2 : 1);
+    }
+
+    // Data access cycles, as TwoLevelCache::memoryAccess
+    int memoryAccess(unsigned long long addr, accessType type) {
+        int cycles = l1d.getHitTime();
+        auto l1_result = l1d.access(addr, type);
+        if (l1_result.first == HIT) return cycles;
+        if (l1_result.second) {
+            cycles += l2.getHitTime();
+            shadowInstall(l2_data_alone, data_w, data_z, l1d.getDirtyVictim());
+            l2.install(l1d.getDirtyVictim());
+        }
+        cycles += l2.getHitTime();
+        data_alone_misses += !shadowAccess(l2_data_alone, data_w, data_z, addr);
+        auto l2_result = l2.access(addr, read_ACCESS);
+        if (l2_result.first == HIT) return cycles;
+        l2_data_misses++;
+        return cycles + dram_penalty * (l2_result.second ? 2 : 1);
+    }
+};
+
+// Compact trace format (version 1):
+//   TraceFileHeader | { TraceBlockHeader | payload } ...
+// Every record is one LEB128 varint holding
+//   zigzag(address - predicted[slot]) << 3 | slot << 1 | is_write
+// where slot picks one of TRACE_STREAMS delta streams and a stream
+// predicts its last address plus its last stride. The encoder uses the
+// stream with the closest prediction, or recycles the least recently used
+// one for a far jump, so interleaved strided streams (GEMM operands,
+// stencil rows) cost one byte per record. Each block header carries its
+// record index and the stream state it starts from, so any block can be
+// decoded on its own for seeking. Addresses must be below 2^60.
+#define TRACE_VERSION 1
+#define TRACE_STREAMS 4
+#define TRACE_BLOCK_RECORDS 65536
+static const char TRACE_MAGIC[8] = {'C', 'S', 'I', 'M', 'T', 'R', 'C', 'E'};
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_records;
+};
+
+struct TraceBlockHeader {
+    uint32_t record_count;
+    uint32_t payload_bytes;
+    uint64_t first_record;
+    uint64_t stream_base[TRACE_STREAMS];
+    uint64_t stream_stride[TRACE_STREAMS];
+};
+
+#define TRACE_NEAR_DISTANCE 4096
+
+// Streaming encoder: records are buffered per block and each full block is
+// written out with its header.
+class TraceWriter {
+private:
+    FILE *file = nullptr;
+    vector<unsigned char> payload;
+    TraceBlockHeader block = {};
+    uint64_t last[TRACE_STREAMS] = {};
+    uint64_t stride[TRACE_STREAMS] = {};
+    uint64_t used[TRACE_STREAMS] = {};
+    uint64_t records = 0;
+    uint32_t block_records = TRACE_BLOCK_RECORDS;
+    bool ok = true;
+
+    void flushBlock() {
+        if (block.record_count == 0) return;
+        block.payload_bytes = (uint32_t)payload.size();
+        ok = ok && fwrite(&block, sizeof(block), 1, file) == 1 &&
+             fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+        payload.clear();
+        block.record_count = 0;
+    }
+
+public:
+    TraceWriter() = default;
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    ~TraceWriter() { close(); }
+
+    bool open(const string& path, uint32_t recordsPerBlock = TRACE_BLOCK_RECORDS) {
+        file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        block_records = recordsPerBlock;
+        TraceFileHeader header = {};
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_VERSION;
+        header.block_records = block_records;
+        ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        payload.reserve((size_t)block_records * 2);
+        return ok;
+    }
+
+    bool append(unsigned long long addr, accessType type) {
+        if (addr >> 60) { ok = false; return false; }
+        if (block.record_count == 0) {
+            block.first_record = records;
+            memcpy(block.stream_base, last, sizeof(last));
+            memcpy(block.stream_stride, stride, sizeof(stride));
+        }
+
+        int slot = 0, lru = 0;
+        uint64_t best = ~0ULL;
+        for (int s = 0; s < TRACE_STREAMS; s++) {
+            int64_t d = (int64_t)(addr - (last[s] + stride[s]));
+            uint64_t distance = d < 0 ? (uint64_t)-d : (uint64_t)d;
+            if (distance < best) { best = distance; slot = s; }
+            if (used[s] < used[lru]) lru = s;
+        }
+        if (best > TRACE_NEAR_DISTANCE) slot = lru;
+        int64_t delta = (int64_t)(addr - (last[slot] + stride[slot]));
+        uint64_t value = ((((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) << 3) |
+                         ((uint64_t)slot << 1) | (type == WRITE_ACCESS ? 1 : 0);
+        while (value >= 0x80) {
+            payload.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        payload.push_back((unsigned char)value);
+        stride[slot] = addr - last[slot];
+        last[slot] = addr;
+        used[slot] = ++records;
+        if (++block.record_count == block_records) flushBlock();
+        return ok;
+    }
+
+    unsigned long long getRecords() const { return records; }
+
+    bool close() {
+        if (!file) return ok;
+        flushBlock();
+        ok = (fclose(file) == 0) && ok;
+        file = nullptr;
+        return ok;
+    }
+};
+
+// Decoder over a mapped trace. open() walks the block headers once to build
+// the seek index; next() decodes straight into caller-provided arrays.
+class TraceReader {
+private:
+    MappedFile file;
+    vector<size_t> block_offsets;
+    vector<uint64_t> block_first;
+    unsigned long long total_records = 0;
+    size_t block = 0;
+    const unsigned char *cursor = nullptr;
+    const unsigned char *payload_end = nullptr;
+    uint32_t remaining = 0;
+    uint64_t last[TRACE_STREAMS] = {};
+    uint64_t stride[TRACE_STREAMS] = {};
+    bool corrupt = false;
+
+    // Headers follow payloads of any length, so they are copied out rather
+    // than read in place
+    TraceBlockHeader blockHeader(size_t offset) const {
+        TraceBlockHeader h;
+        memcpy(&h, file.data() + offset, sizeof(h));
+        return h;
+    }
+
+    void enterBlock(size_t b) {
+        block = b;
+        if (b >= block_offsets.size()) { remaining = 0; return; }
+        TraceBlockHeader h = blockHeader(block_offsets[b]);
+        memcpy(last, h.stream_base, sizeof(last));
+        memcpy(stride, h.stream_stride, sizeof(stride));
+        cursor = (const unsigned char*)file.data() + block_offsets[b] + sizeof(TraceBlockHeader);
+        payload_end = cursor + h.payload_bytes;
+        remaining = h.record_count;
+    }
+
+    // A varint ran past its block's payload or beyond 10 bytes: end the
+    // stream here
+    void fail() {
+        corrupt = true;
+        remaining = 0;
+        block = block_offsets.size();
+    }
+
+public:
+    bool open(const string& path) {
+        if (!file.open(path) || file.size() < sizeof(TraceFileHeader)) return false;
+        TraceFileHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 || header.version != TRACE_VERSION) {
+            return false;
+        }
+        size_t offset = sizeof(TraceFileHeader);
+        while (offset + sizeof(TraceBlockHeader) <= file.size()) {
+            TraceBlockHeader h = blockHeader(offset);
+            // Every record takes at least one payload byte
+            if (offset + sizeof(TraceBlockHeader) + h.payload_bytes > file.size() ||
+                h.record_count > h.payload_bytes || h.first_record != total_records) {
+                return false;
+            }
+            block_offsets.push_back(offset);
+            block_first.push_back(h.first_record);
+            total_records += h.record_count;
+            offset += sizeof(TraceBlockHeader) + h.payload_bytes;
+        }
+        enterBlock(0);
+        return true;
+    }
+
+    // True once next() met a record that does not decode within its block
+    bool isCorrupt() const { return corrupt; }
+
+    unsigned long long getTotalRecords() const { return total_records; }
+
+    // Position the reader so next() returns `record` first
+    bool seek(unsigned long long record) {
+        if (record >= total_records) return false;
+        size_t b = upper_bound(block_first.begin(), block_first.end(), record) - block_first.begin() - 1;
+        enterBlock(b);
+        unsigned long long addr;
+        unsigned char write;
+        for (uint64_t skip = record - block_first[b]; skip > 0; skip--) {
+            if (next(&addr, &write, 1) == 0) return false;
+        }
+        return true;
+    }
+
+    // Decode up to n records; returns how many were produced (0 at the end)
+    int next(unsigned long long *addrs, unsigned char *writes, int n) {
+        int produced = 0;
+        while (produced < n) {
+            if (remaining == 0) {
+                if (block + 1 >= block_offsets.size()) break;
+                enterBlock(block + 1);
+                continue;
+            }
+            int count = (int)min<uint32_t>(remaining, (uint32_t)(n - produced));
+            const unsigned char *p = cursor;
+            for (int i = 0; i < count; i++) {
+                if (p == payload_end) { fail(); return produced + i; }
+                uint64_t value = *p++;
+                if (value & 0x80) {
+                    value &= 0x7F;
+                    int shift = 7;
+                    uint64_t byte;
+                    do {
+                        // At most 10 bytes: the 10th carries bit 63
+                        if (p == payload_end || shift > 63) { fail(); return produced + i; }
+                        byte = *p++;
+                        value |= (byte & 0x7F) << shift;
+                        shift += 7;
+                    } while (byte & 0x80);
+                }
+                uint64_t zz = value >> 3;
+                int slot = (int)(value >> 1) & (TRACE_STREAMS - 1);
+                uint64_t addr = last[slot] + stride[slot] + ((zz >> 1) ^ (0 - (zz & 1)));
+                stride[slot] = addr - last[slot];
+                last[slot] = addr;
+                addrs[produced + i] = addr;
+                writes[produced + i] = (unsigned char)(value & 1);
+            }
+            cursor = p;
+            remaining -= count;
+            produced += count;
+        }
+        return produced;
+    }
+};
+
+// Importers for third-party trace formats. Each one walks a mapped file
+// with std::from_chars and hands every data access to sink(addr, type);
+// instruction fetches are only counted. Importers return false if the file
+// cannot be mapped.
+//   DINERO_TRACE:   Dinero IV "din" text, "<label> <hex address>" per line
+//                   (0 read, 1 write, 2 ifetch; escapes and negative
+//                   labels are skipped)
+//   LACKEY_TRACE:   Valgrind Lackey --trace-mem output, "I/L/S/M addr,size"
+//                   (M is a read followed by a write)
+//   CHAMPSIM_TRACE: uncompressed ChampSim input_instr records (64 bytes);
+//                   source_memory are reads, destination_memory writes
+enum TraceFormat { NATIVE_TRACE, DINERO_TRACE, LACKEY_TRACE, CHAMPSIM_TRACE };
+
+inline bool parseTraceFormat(const string& name, TraceFormat& format) {
+    if (name == "native") format = NATIVE_TRACE;
+    else if (name == "din" || name == "dinero") format = DINERO_TRACE;
+    else if (name == "lackey") format = LACKEY_TRACE;
+    else if (name == "champsim") format = CHAMPSIM_TRACE;
+    else return false;
+    return true;
+}
+
+struct ImportStats {
+    unsigned long long instructions = 0;
+    unsigned long long reads = 0;
+    unsigned long long writes = 0;
+    unsigned long long skipped = 0;     // unparsable lines and escapes
+};
+
+struct ChampSimRecord {
+    unsigned long long ip;
+    unsigned char is_branch;
+    unsigned char branch_taken;
+    unsigned char destination_registers[2];
+    unsigned char source_registers[4];
+    unsigned long long destination_memory[2];
+    unsigned long long source_memory[4];
+};
+
+inline const char* skipBlanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+inline const char* nextLine(const char *p, const char *end) {
+    const char *nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+template <typename Sink>
+void parseDinero(const char *p, const char *end, Sink& sink, ImportStats& stats) {
+    while (p < end) {
+        const char *line_end = nextLine(p, end);
+        p = skipBlanks(p, line_end);
+        int label;
+        auto r = from_chars(p, line_end, label);
+        unsigned long long addr;
+        if (r.ec == errc() && label >= 0 && label <= 2 &&
+            from_chars(skipBlanks(r.ptr, line_end), line_end, addr, 16).ec == errc()) {
+            if (label == 2) {
+                stats.instructions++;
+            } else if (label == 1) {
+                stats.writes++;
+                sink(addr, WRITE_ACCESS);
+            } else {
+                stats.reads++;
+                sink(addr, read_ACCESS);
+            }
+        } else if (p < line_end && *p != '\n' && *p != '\r') {
+            stats.skipped++;
+        }
+        p = line_end;
+    }
+}
+
+template <typename Sink>
+void parseLackey(const char *p, const char *end, Sink& sink, ImportStats& stats) {
+    while (p < end) {
+        const char *line_end = nextLine(p, end);
+        p = skipBlanks(p, line_end);
+        unsigned long long addr;
+        char kind = p < line_end ? *p : 0;
+        if ((kind == 'I' || kind == 'L' || kind == 'S' || kind == 'M') &&
+            from_chars(skipBlanks(p + 1, line_end), line_end, addr, 16).ec == errc()) {
+            if (kind == 'I') {
+                stats.instructions++;
+            } else {
+                if (kind != 'S') { stats.reads++; sink(addr, read_ACCESS); }
+                if (kind != 'L') { stats.writes++; sink(addr, WRITE_ACCESS); }
+            }
+        } else if (kind && kind != '\n' && kind != '\r') {
+            stats.skipped++;    // "==pid==" banners and other tool output
+        }
+        p = line_end;
+    }
+}
+
+template <typename Sink>
+void parseChampSim(const char *p, const char *end, Sink& sink, ImportStats& stats) {
+    size_t count = (end - p) / sizeof(ChampSimRecord);
+    stats.instructions += count;
+    for (size_t i = 0; i < count; i++) {
+        ChampSimRecord rec;
+        memcpy(&rec, p + i * sizeof(ChampSimRecord), sizeof(rec));
+        for (int s = 0; s < 4; s++) {
+            if (rec.source_memory[s]) { stats.reads++; sink(rec.source_memory[s], read_ACCESS); }
+        }
+        for (int d = 0; d < 2; d++) {
+            if (rec.destination_memory[d]) { stats.writes++; sink(rec.destination_memory[d], WRITE_ACCESS); }
+        }
+    }
+}
+
+template <typename Sink>
+bool importTrace(TraceFormat format, const string& path, Sink&& sink, ImportStats& stats) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    const char *begin = file.data(), *end = file.data() + file.size();
+    if (format == DINERO_TRACE) parseDinero(begin, end, sink, stats);
+    else if (format == LACKEY_TRACE) parseLackey(begin, end, sink, stats);
+    else if (format == CHAMPSIM_TRACE) parseChampSim(begin, end, sink, stats);
+    else return false;
+    return true;
+}
+
+// Convert a third-party trace into the native compact format
+inline bool convertTrace(TraceFormat format, const string& in, const string& out, ImportStats& stats) {
+    TraceWriter writer;
+    if (!writer.open(out)) return false;
+    bool ok = importTrace(format, in, [&](unsigned long long addr, accessType type) { writer.append(addr, type); }, stats);
+    return writer.close() && ok;
+}
+
+// Producer/consumer pipeline between address generation (or trace
+// decoding) and the simulator thread.
+
+// One batch of the instruction stream: `instructions` instructions of which
+// `count` are the memory accesses listed in addrs/writes
+struct AccessBatch {
+    int instructions = 0;
+    int count = 0;
+    bool warm = false;                  // functional warmup: no cycles or statistics
+    unsigned long long addrs[BULK_BLOCK];
+    unsigned char writes[BULK_BLOCK];
+};
+
+struct PipelineStats {
+    unsigned long long batches = 0;
+    unsigned long long producer_stalls = 0;    // ring was full
+    unsigned long long consumer_stalls = 0;    // ring was empty
+    double producer_stall_ms = 0.0;
+    double consumer_stall_ms = 0.0;
+
+    void add(const PipelineStats& o) {
+        batches += o.batches;
+        producer_stalls += o.producer_stalls;
+        consumer_stalls += o.consumer_stalls;
+        producer_stall_ms += o.producer_stall_ms;
+        consumer_stall_ms += o.consumer_stall_ms;
+    }
+};
+
+// Lock-free single-producer/single-consumer ring of in-place slots. The
+// producer fills the slot returned by beginWrite() and publishes it with
+// commitWrite(); the consumer mirrors that with beginRead()/commitRead().
+// Each side caches the other's index and only reloads it when the ring
+// looks full (or empty).
+template <typename T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) size_t cached_tail = 0;
+    alignas(64) atomic<size_t> tail{0};
+    alignas(64) size_t cached_head = 0;
+    alignas(64) atomic<bool> closed{false};
+
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n *= 2;
+        slots.resize(n);
+        mask = n - 1;
+    }
+
+    T* beginWrite() {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - cached_head == slots.size()) {
+            cached_head = head.load(memory_order_acquire);
+            if (t - cached_head == slots.size()) return nullptr;
+        }
+        return &slots[t & mask];
+    }
+    void commitWrite() { tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release); }
+
+    T* beginRead() {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(memory_order_acquire);
+            if (h == cached_tail) return nullptr;
+        }
+        return &slots[h & mask];
+    }
+    void commitRead() { head.store(head.load(memory_order_relaxed) + 1, memory_order_release); }
+
+    void close() { closed.store(true, memory_order_release); }
+    bool isClosed() const { return closed.load(memory_order_acquire); }
+};
+
+// Runs `produce` (bool(AccessBatch&), false once the stream is exhausted)
+// on its own thread and drains the batches through the hierarchy on the
+// calling thread. A full ring blocks the producer (backpressure); both
+// sides spin briefly, then yield. Returns total cycles, counting one cycle
+// per non-memory instruction as in runBlocks.
+template <typename Producer>
+unsigned long long runPipeline(Producer produce, TwoLevelCache& cache, PipelineStats& stats, size_t ring_batches = 8) {
+    SpscRing<AccessBatch> ring(ring_batches);
+    typedef chrono::steady_clock clock;
+
+    thread producer([&]() {
+        while (true) {
+            AccessBatch *batch = ring.beginWrite();
+            if (!batch) {
+                stats.producer_stalls++;
+                auto start = clock::now();
+                for (int spins = 0; !(batch = ring.beginWrite()); spins++) {
+                    if (spins > 64) this_thread::yield();
+                }
+                stats.producer_stall_ms += chrono::duration<double, milli>(clock::now() - start).count();
+            }
+            if (!produce(*batch)) break;
+            ring.commitWrite();
+        }
+        ring.close();
+    });
+
+    unsigned long long total_cycles = 0;
+    unsigned long long consumer_stalls = 0;
+    double consumer_stall_ms = 0.0;
+    while (true) {
+        AccessBatch *batch = ring.beginRead();
+        if (!batch) {
+            consumer_stalls++;
+            auto start = clock::now();
+            for (int spins = 0; !(batch = ring.beginRead()); spins++) {
+                // close() is released after the last commit, so one more look
+                // after seeing it closed catches the final batch
+                if (ring.isClosed() && !(batch = ring.beginRead())) break;
+                if (spins > 64) this_thread::yield();
+            }
+            consumer_stall_ms += chrono::duration<double, milli>(clock::now() - start).count();
+            if (!batch) break;
+        }
+        if (batch->warm) {
+            for (int i = 0; i < batch->count; i++) cache.warmAccess(batch->addrs[i], batch->writes[i] ? WRITE_ACCESS : read_ACCESS);
+        } else {
+            total_cycles += batch->instructions - batch->count;
+            cache.advance(batch->instructions - batch->count);
+            for (int i = 0; i < batch->count; i++) {
+                total_cycles += cache.memoryAccess(batch->addrs[i], batch->writes[i] ? WRITE_ACCESS : read_ACCESS);
+            }
+        }
+        stats.batches++;
+        ring.commitRead();
+    }
+    producer.join();
+    stats.consumer_stalls += consumer_stalls;
+    stats.consumer_stall_ms += consumer_stall_ms;
+    return total_cycles;
+}
+
+#define SHARD_CHUNK (1 << 20)
+
+// Persistent workers for the sharded phases. run(fn) calls fn(w) for w in
+// [0, size()), w == 0 on the caller, and returns once all have finished.
+// Each worker owns a job slot on its own cache line: the caller posts the
+// phase number there and the worker reports it back when done. Both sides
+// spin briefly, then block on the slot (atomic wait), so idle workers
+// cost nothing between chunks and no thread is created per phase.
+class WorkerPool {
+private:
+    struct alignas(64) Slot {
+        atomic<uint64_t> posted{0};
+        atomic<uint64_t> done{0};
+    };
+    unique_ptr<Slot[]> slots;
+    vector<thread> threads;
+    int workers;
+    uint64_t phase = 0;
+    void (*call)(void*, int) = nullptr;
+    void *job = nullptr;
+    atomic<bool> stopping{false};
+
+    static void await(const atomic<uint64_t>& value, uint64_t old) {
+        for (int spins = 0; value.load(memory_order_acquire) == old; spins++) {
+            if (spins > 256) value.wait(old, memory_order_acquire);
+        }
+    }
+
+    void loop(int w) {
+        uint64_t seen = 0;
+        while (true) {
+            await(slots[w].posted, seen);
+            seen = slots[w].posted.load(memory_order_acquire);
+            if (stopping.load(memory_order_acquire)) return;
+            call(job, w);
+            slots[w].done.store(seen, memory_order_release);
+            slots[w].done.notify_one();
+        }
+    }
+
+    void post() {
+        phase++;
+        for (int w = 1; w < workers; w++) {
+            slots[w].posted.store(phase, memory_order_release);
+            slots[w].posted.notify_one();
+        }
+    }
+
+public:
+    explicit WorkerPool(int n) : slots(new Slot[max(1, n)]), workers(max(1, n)) {
+        for (int w = 1; w < workers; w++) threads.emplace_back([this, w]() { loop(w); });
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool() {
+        stopping.store(true, memory_order_release);
+        post();
+        for (auto& t : threads) t.join();
+    }
+
+    int size() const { return workers; }
+
+    template <typename Fn>
+    void run(Fn&& fn) {
+        if (workers == 1) { fn(0); return; }
+        job = (void*)&fn;
+        call = [](void *f, int w) { (*(remove_reference_t<Fn>*)f)(w); };
+        post();
+        fn(0);
+        for (int w = 1; w < workers; w++) {
+            uint64_t done;
+            while ((done = slots[w].done.load(memory_order_acquire)) != phase) await(slots[w].done, done);
+        }
+    }
+};
+
+// One cache level split by set index across shards, one worker per shard.
+// Shard s owns the sets with set % shards == s and simulates them in a
+// private Cache of sets / shards sets, fed with the remapped address
+// (tag * (sets / shards) + set / shards) * line_size, which lands in the
+// same relative set with the same tag. Sets only interact through the
+// replacement RNG, so each shard keeps its own RNG stream; everything
+// else matches a single Cache exactly.
+class ShardedCache {
+private:
+    WorkerPool& pool;                               // one worker per shard
+    vector<unique_ptr<Cache>> shards;
+    vector<pair<unsigned int, unsigned int>> rng;   // per-shard (m_w, m_z)
+    unsigned long long line_size, num_sets, shard_sets;
+    int num_shards;
+    int line_shift = -1, set_shift = -1, shard_shift = -1;    // -1: not a power of two
+    // buckets[router][shard]: indices of the router's accesses owned by shard
+    vector<vector<vector<uint32_t>>> buckets;
+
+    bool pow2() const { return line_shift >= 0 && set_shift >= 0 && shard_shift >= 0; }
+
+    // Owning shard and address inside it. For power-of-two geometries the
+    // remap just drops the shard bits from the set index.
+    int shardOf(unsigned long long addr) const {
+        if (pow2()) return (int)((addr >> line_shift) & (num_shards - 1));
+        return (int)((addr / line_size) % num_sets % num_shards);
+    }
+    unsigned long long remap(unsigned long long addr) const {
+        if (pow2()) {
+            unsigned long long low_mask = (1ULL << line_shift) - 1;
+            return ((addr >> (line_shift + shard_shift)) << line_shift) | (addr & low_mask);
+        }
+        unsigned long long block = addr / line_size;
+        unsigned long long set = block % num_sets, tag = block / num_sets;
+        return (tag * shard_sets + set / num_shards) * line_size;
+    }
+    // Inverse of remap() for a line of shard s
+    unsigned long long unmap(int s, unsigned long long addr) const {
+        if (pow2()) {
+            unsigned long long low_mask = (1ULL << line_shift) - 1;
+            return ((((addr >> line_shift) << shard_shift) | (unsigned long long)s) << line_shift) | (addr & low_mask);
+        }
+        unsigned long long block = addr / line_size;
+        unsigned long long tag = block / shard_sets, set = block % shard_sets * num_shards + s;
+        return (tag * num_sets + set) * line_size;
+    }
+
+public:
+    ShardedCache(int size, int lineSize, int assoc, int hitTime, WorkerPool& workers, unsigned long long seed)
+        : pool(workers), line_size(lineSize), num_shards(workers.size()) {
+        num_sets = size / (lineSize * assoc);
+        shard_sets = num_sets / num_shards;
+        for (int s = 0; s < num_shards; s++) {
+            shards.push_back(make_unique<Cache>(size / num_shards, lineSize, assoc, hitTime));
+            uint64_t h = mix64(seed + s);
+            rng.push_back({(unsigned int)h | 1, (unsigned int)(h >> 32) | 1});
+        }
+        buckets.assign(num_shards, vector<vector<uint32_t>>(num_shards));
+        auto log2_exact = [](unsigned long long v) { return (v & (v - 1)) ? -1 : __builtin_ctzll(v); };
+        line_shift = log2_exact(line_size);
+        set_shift = log2_exact(num_sets);
+        shard_shift = log2_exact(num_shards);
+    }
+
+    int getHitTime() const { return shards[0]->getHitTime(); }
+    unsigned long long getHits() const { unsigned long long n = 0; for (auto& c : shards) n += c->getHits(); return n; }
+    unsigned long long getMisses() const { unsigned long long n = 0; for (auto& c : shards) n += c->getMisses(); return n; }
+    unsigned long long getWritebacks() const { unsigned long long n = 0; for (auto& c : shards) n += c->getWritebacks(); return n; }
+
+    // Simulate n accesses in order; outcome[i] gets bit 0 = hit, bit 1 =
+    // writeback, and victims[i] (if given) the dirty line a writeback
+    // evicted. With installs, writes[i] marks a dirty line from the level
+    // above (Cache::install) instead of a store. Workers first route their
+    // slice of the input into per-shard buckets, then each shard drains its
+    // buckets router by router, which preserves the original order within
+    // every set. detailed == false takes the functional warm path.
+    void access(const unsigned long long *addrs, const unsigned char *writes, size_t n, unsigned char *outcome,
+                bool detailed = true, unsigned long long *victims = nullptr, bool installs = false) {
+        unsigned int caller_w = m_w, caller_z = m_z;
+        if (num_shards > 1) {
+            pool.run([&](int w) {
+                size_t begin = n * w / num_shards, end = n * (w + 1) / num_shards;
+                for (auto& b : buckets[w]) b.clear();
+                for (size_t i = begin; i < end; i++) buckets[w][shardOf(addrs[i])].push_back((uint32_t)i);
+            });
+        }
+        pool.run([&](int s) {
+            m_w = rng[s].first;
+            m_z = rng[s].second;
+            Cache& cache = *shards[s];
+            auto step = [&](uint32_t i) {
+                accessType type = writes && writes[i] ? WRITE_ACCESS : read_ACCESS;
+                bool hit, writeback;
+                if (installs && type == WRITE_ACCESS) {
+                    hit = true;
+                    writeback = detailed ? cache.install(remap(addrs[i])) : cache.install<false>(remap(addrs[i]));
+                } else if (detailed) {
+                    auto r = cache.access(remap(addrs[i]), type);
+                    hit = r.first == HIT;
+                    writeback = r.second;
+                } else {
+                    hit = cache.warm(remap(addrs[i]), type);
+                    writeback = !hit && cache.getDirtyVictim() != NO_VICTIM;
+                }
+                outcome[i] = (unsigned char)hit | (unsigned char)(writeback << 1);
+                if (writeback && victims) victims[i] = unmap(s, cache.getDirtyVictim());
+            };
+            if (num_shards == 1) {
+                for (size_t i = 0; i < n; i++) step((uint32_t)i);
+            } else {
+                for (int w = 0; w < num_shards; w++) {
+                    for (uint32_t i : buckets[w][s]) step(i);
+                }
+            }
+            rng[s] = {m_w, m_z};
+        });
+        m_w = caller_w;
+        m_z = caller_z;
+    }
+};
+
+// Two-level hierarchy over set-sharded levels. A chunk runs through all of
+// L1 first; its misses, in order, then run through L2 exactly as
+// TwoLevelCache::memoryAccess issues them (the dirty victim's install,
+// then the read), and the per-access cycles are rebuilt from the two
+// outcome arrays.
+class ShardedHierarchy {
+private:
+    unique_ptr<WorkerPool> pool;                    // before the levels that use it
+    unique_ptr<ShardedCache> l1_cache, l2_cache;
+    int dram_penalty, num_shards;
+    unsigned long long total_accesses = 0;
+    unsigned long long total_cycles = 0;
+    vector<unsigned char> l1_outcome, l2_outcome;
+    vector<unsigned long long> l1_victims, miss_addrs;
+    vector<unsigned char> miss_writes;
+    vector<uint32_t> miss_offset;
+
+    // Run a chunk through L1, then its L1 misses (each after its dirty
+    // victim's install), in order, through L2
+    void runLevels(const unsigned long long *addrs, const unsigned char *writes, size_t n, bool detailed) {
+        l1_outcome.resize(n);
+        l1_victims.resize(n);
+        l1_cache->access(addrs, writes, n, l1_outcome.data(), detailed, l1_victims.data());
+
+        // Gather L2 requests in order: per-slice counts, prefix sum, scatter
+        miss_offset.assign(num_shards + 1, 0);
+        pool->run([&](int w) {
+            size_t begin = n * w / num_shards, end = n * (w + 1) / num_shards;
+            uint32_t requests = 0;
+            for (size_t i = begin; i < end; i++) {
+                if (!(l1_outcome[i] & 1)) requests += 1 + ((l1_outcome[i] >> 1) & 1);
+            }
+            miss_offset[w + 1] = requests;
+        });
+        for (int w = 0; w < num_shards; w++) miss_offset[w + 1] += miss_offset[w];
+        miss_addrs.resize(miss_offset[num_shards]);
+        miss_writes.resize(miss_offset[num_shards]);
+        pool->run([&](int w) {
+            size_t begin = n * w / num_shards, end = n * (w + 1) / num_shards;
+            uint32_t m = miss_offset[w];
+            for (size_t i = begin; i < end; i++) {
+                if (l1_outcome[i] & 1) continue;
+                if (l1_outcome[i] & 2) {
+                    miss_addrs[m] = l1_victims[i];
+                    miss_writes[m++] = 1;
+                }
+                miss_addrs[m] = addrs[i];
+                miss_writes[m++] = 0;
+            }
+        });
+        l2_outcome.resize(miss_addrs.size());
+        l2_cache->access(miss_addrs.data(), miss_writes.data(), miss_addrs.size(), l2_outcome.data(), detailed, nullptr, true);
+    }
+
+public:
+    // The shard count is lowered to the largest value dividing both levels' set counts
+    ShardedHierarchy(int l1_line_size, const HierarchyConfig& config, int shards, unsigned long long seed)
+        : dram_penalty(config.dram_penalty) {
+        int l1_sets = config.l1_size / (l1_line_size * config.l1_assoc);
+        int l2_sets = config.l2_size / (config.l2_line_size * config.l2_assoc);
+        num_shards = max(1, min(shards, min(l1_sets, l2_sets)));
+        while (l1_sets % num_shards || l2_sets % num_shards) num_shards--;
+        pool = make_unique<WorkerPool>(num_shards);
+        l1_cache = make_unique<ShardedCache>(config.l1_size, l1_line_size, config.l1_assoc, config.l1_hit_time,
+                                             *pool, mix64(seed));
+        l2_cache = make_unique<ShardedCache>(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time,
+                                             *pool, mix64(seed + 1));
+    }
+
+    int getShards() const { return num_shards; }
+    const ShardedCache& getL1Cache() const { return *l1_cache; }
+    const ShardedCache& getL2Cache() const { return *l2_cache; }
+    double getAverageAccessTime() const {
+        return total_accesses > 0 ? (double)total_cycles / total_accesses : 0.0;
+    }
+
+    // Functional warmup of n accesses: contents and replacement state only
+    void warm(const unsigned long long *addrs, const unsigned char *writes, size_t n) {
+        runLevels(addrs, writes, n, false);
+    }
+
+    // Simulate n accesses (n < 2^32); cycles[i] receives each access' latency
+    // when non-null. Returns the chunk's total cycles.
+    unsigned long long access(const unsigned long long *addrs, const unsigned char *writes, size_t n,
+                              uint32_t *cycles = nullptr) {
+        runLevels(addrs, writes, n, true);
+
+        // Per-access cycles, as in TwoLevelCache::memoryAccess
+        vector<unsigned long long> slice_cycles(num_shards, 0);
+        int l1_time = l1_cache->getHitTime(), l2_time = l2_cache->getHitTime();
+        pool->run([&](int w) {
+            size_t begin = n * w / num_shards, end = n * (w + 1) / num_shards;
+            uint32_t m = miss_offset[w];
+            unsigned long long sum = 0;
+            for (size_t i = begin; i < end; i++) {
+                uint32_t c = l1_time;
+                if (!(l1_outcome[i] & 1)) {
+                    m += (l1_outcome[i] >> 1) & 1;      // the victim's install
+                    unsigned char l2 = l2_outcome[m++];
+                    c += l2_time * (1 + ((l1_outcome[i] >> 1) & 1));
+                    if (!(l2 & 1)) c += dram_penalty * (1 + ((l2 >> 1) & 1));
+                }
+                if (cycles) cycles[i] = c;
+                sum += c;
+            }
+            slice_cycles[w] = sum;
+        });
+        unsigned long long chunk_cycles = accumulate(slice_cycles.begin(), slice_cycles.end(), 0ULL);
+        total_accesses += n;
+        total_cycles += chunk_cycles;
+        return chunk_cycles;
+    }
+};
+
+// Event-driven timing. Components exchange request/response messages
+// through an engine whose pending events sit in a hierarchical timing
+// wheel: four levels of 256 slots (one cycle, 256 cycles, 64K cycles, 16M
+// cycles per slot) plus an overflow list. An event goes to the level of
+// the highest byte in which its time differs from now, and slots cascade
+// down as time reaches them. Events come from a chunked free-list pool, so
+// the steady state allocates nothing, and each slot is a FIFO so events
+// for the same cycle run in the order they were scheduled.
+#define WHEEL_BITS 8
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define EVENT_POOL_CHUNK 4096
+#define MSG_STACK_DEPTH 4
+
+// A writeback carries a dirty victim down one level and gets no response
+enum MessageKind { MSG_REQUEST = 0, MSG_RESPONSE = 1, MSG_WRITEBACK = 2 };
+
+class SimComponent;
+
+// A request carries the chain of components it passed through; each level
+// pushes itself when forwarding and the response is popped back up
+struct SimMessage {
+    unsigned long long addr = 0;
+    uint32_t id = 0;
+    uint8_t kind = MSG_REQUEST;
+    uint8_t type = read_ACCESS;
+    uint8_t depth = 0;
+    SimComponent *route[MSG_STACK_DEPTH];
+
+    void push(SimComponent *c) { route[depth++] = c; }
+    SimComponent* pop() { return route[--depth]; }
+};
+
+struct SimEvent {
+    unsigned long long time;
+    SimEvent *next;
+    SimComponent *target;
+    SimMessage msg;
+};
+
+class EventEngine;
+
+class SimComponent {
+public:
+    virtual ~SimComponent() = default;
+    virtual void handle(EventEngine& engine, SimMessage& msg) = 0;
+};
+
+class EventEngine {
+private:
+    struct Slot {
+        SimEvent *head = nullptr, *tail = nullptr;
+    };
+    Slot wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_SLOTS / 64] = {};   // non-empty level-0 slots
+    Slot overflow;
+    vector<unique_ptr<SimEvent[]>> chunks;
+    SimEvent *free_list = nullptr;
+    unsigned long long now = 0, pending = 0, processed = 0;
+
+    SimEvent* allocate() {
+        if (!free_list) {
+            chunks.push_back(make_unique<SimEvent[]>(EVENT_POOL_CHUNK));
+            SimEvent *chunk = chunks.back().get();
+            for (int i = 0; i < EVENT_POOL_CHUNK; i++) {
+                chunk[i].next = free_list;
+                free_list = &chunk[i];
+            }
+        }
+        SimEvent *e = free_list;
+        free_list = e->next;
+        return e;
+    }
+
+    static void append(Slot& slot, SimEvent *e) {
+        e->next = nullptr;
+        if (slot.tail) slot.tail->next = e;
+        else slot.head = e;
+        slot.tail = e;
+    }
+
+    void insert(SimEvent *e) {
+        unsigned long long diff = e->time ^ now;
+        if (diff < (1ULL << WHEEL_BITS)) {
+            unsigned int slot = (unsigned int)(e->time & (WHEEL_SLOTS - 1));
+            append(wheel[0][slot], e);
+            occupied[slot >> 6] |= 1ULL << (slot & 63);
+            return;
+        }
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if (diff < (1ULL << (WHEEL_BITS * (level + 1)))) {
+                append(wheel[level][(e->time >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)], e);
+                return;
+            }
+        }
+        append(overflow, e);
+    }
+
+    // Re-insert every event of a slot relative to the current time
+    void cascade(Slot& slot) {
+        SimEvent *e = slot.head;
+        slot.head = slot.tail = nullptr;
+        while (e) {
+            SimEvent *next = e->next;
+            insert(e);
+            e = next;
+        }
+    }
+
+    // First occupied level-0 slot at or after now's slot, or -1
+    int nextOccupied() const {
+        unsigned int from = (unsigned int)(now & (WHEEL_SLOTS - 1));
+        for (unsigned int word = from >> 6; word < WHEEL_SLOTS / 64; word++) {
+            uint64_t bits = occupied[word];
+            if (word == from >> 6) bits &= ~0ULL << (from & 63);
+            if (bits) return (int)(word * 64 + __builtin_ctzll(bits));
+        }
+        return -1;
+    }
+
+public:
+    EventEngine() = default;
+    EventEngine(const EventEngine&) = delete;
+    EventEngine& operator=(const EventEngine&) = delete;
+
+    unsigned long long getNow() const { return now; }
+    unsigned long long getProcessed() const { return processed; }
+    unsigned long long getPending() const { return pending; }
+
+    void schedule(unsigned long long delay, SimComponent *target, const SimMessage& msg) {
+        SimEvent *e = allocate();
+        e->time = now + delay;
+        e->target = target;
+        e->msg = msg;
+        insert(e);
+        pending++;
+    }
+
+    // Process events in time order until none are left
+    void run() {
+        while (pending > 0) {
+            int slot = nextOccupied();
+            if (slot < 0) {
+                // Nothing left in this 256-cycle window: move to the next one
+                // and pull its events down from the upper levels
+                now = (now | (WHEEL_SLOTS - 1)) + 1;
+                if ((now & 0xFFFFFFFFULL) == 0) cascade(overflow);
+                for (int level = WHEEL_LEVELS - 1; level >= 1; level--) {
+                    if ((now & ((1ULL << (WHEEL_BITS * level)) - 1)) == 0) {
+                        cascade(wheel[level][(now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)]);
+                    }
+                }
+                continue;
+            }
+            now = (now & ~(unsigned long long)(WHEEL_SLOTS - 1)) | (unsigned long long)slot;
+            Slot& s = wheel[0][slot];
+            // Handlers may append same-cycle events to this slot; they run
+            // in this pass
+            while (s.head) {
+                SimEvent *e = s.head;
+                s.head = e->next;
+                if (!s.head) s.tail = nullptr;
+                e->target->handle(*this, e->msg);
+                e->next = free_list;
+                free_list = e;
+                pending--;
+                processed++;
+            }
+            occupied[slot >> 6] &= ~(1ULL << (slot & 63));
+        }
+    }
+};
+
+// A cache level as a component. A request is looked up on arrival; a hit
+// responds after the hit time, a miss forwards a read to the next level
+// after the hit time (plus the next level's hit time for a writeback, as
+// in TwoLevelCache::memoryAccess). A dirty victim goes down as a writeback
+// after the hit time, ahead of the read. Responses pass straight back up.
+class CacheComponent : public SimComponent {
+private:
+    Cache cache;
+    SimComponent *next_level;
+    int writeback_delay;
+
+public:
+    CacheComponent(int size, int lineSize, int assoc, int hitTime, SimComponent *next, int writebackDelay)
+        : cache(size, lineSize, assoc, hitTime), next_level(next), writeback_delay(writebackDelay) {}
+
+    Cache& getCache() { return cache; }
+
+    void writeBack(EventEngine& engine) {
+        SimMessage wb;
+        wb.kind = MSG_WRITEBACK;
+        wb.addr = cache.getDirtyVictim();
+        wb.type = WRITE_ACCESS;
+        engine.schedule(cache.getHitTime(), next_level, wb);
+    }
+
+    void handle(EventEngine& engine, SimMessage& msg) override {
+        if (msg.kind == MSG_RESPONSE) {
+            SimComponent *up = msg.pop();
+            engine.schedule(0, up, msg);
+            return;
+        }
+        if (msg.kind == MSG_WRITEBACK) {
+            if (cache.install(msg.addr)) writeBack(engine);
+            return;
+        }
+        auto result = cache.access(msg.addr, (accessType)msg.type);
+        if (result.second) writeBack(engine);
+        if (result.first == HIT) {
+            msg.kind = MSG_RESPONSE;
+            engine.schedule(cache.getHitTime(), msg.pop(), msg);
+            return;
+        }
+        msg.push(this);
+        msg.type = read_ACCESS;
+        engine.schedule(cache.getHitTime() + (result.second ? writeback_delay : 0), next_level, msg);
+    }
+};
+
+// Memory with a fixed latency. A non-zero occupancy keeps the channel busy
+// for that many cycles per request or writeback, so overlapping requests
+// queue.
+class MemoryComponent : public SimComponent {
+private:
+    int latency, occupancy;
+    unsigned long long busy_until = 0;
+
+public:
+    explicit MemoryComponent(int latency_cycles, int occupancy_cycles = 0)
+        : latency(latency_cycles), occupancy(occupancy_cycles) {}
+
+    void handle(EventEngine& engine, SimMessage& msg) override {
+        unsigned long long start = max(engine.getNow(), busy_until);
+        busy_until = start + occupancy;
+        if (msg.kind == MSG_WRITEBACK) return;
+        msg.kind = MSG_RESPONSE;
+        engine.schedule(start - engine.getNow() + latency, msg.pop(), msg);
+    }
+};
+
+// Issues a sequence of accesses into the hierarchy, at most one per cycle
+// and at most `window` outstanding, and records each access' latency
+class AccessDriver : public SimComponent {
+private:
+    const unsigned long long *addrs;
+    const unsigned char *writes;
+    size_t count, issued = 0;
+    int window, outstanding = 0;
+    bool issue_pending = false;
+    SimComponent *first_level;
+    vector<unsigned long long> issue_time;
+    unsigned long long total_latency = 0, finish_time = 0;
+
+    void scheduleIssue(EventEngine& engine, unsigned long long delay) {
+        SimMessage tick;
+        tick.kind = MSG_REQUEST;
+        tick.depth = 0;
+        issue_pending = true;
+        engine.schedule(delay, this, tick);
+    }
+
+public:
+    AccessDriver(const unsigned long long *a, const unsigned char *w, size_t n, int maxOutstanding, SimComponent *l1)
+        : addrs(a), writes(w), count(n), window(max(1, maxOutstanding)), first_level(l1), issue_time(n) {}
+
+    void start(EventEngine& engine) { if (count) scheduleIssue(engine, 0); }
+
+    unsigned long long getTotalLatency() const { return total_latency; }
+    unsigned long long getFinishTime() const { return finish_time; }
+
+    void handle(EventEngine& engine, SimMessage& msg) override {
+        if (msg.kind == MSG_RESPONSE) {
+            total_latency += engine.getNow() - issue_time[msg.id];
+            finish_time = engine.getNow();
+            outstanding--;
+            if (!issue_pending && issued < count) scheduleIssue(engine, 0);
+            return;
+        }
+        // Issue tick
+        issue_pending = false;
+        if (issued == count || outstanding == window) return;
+        SimMessage req;
+        req.addr = addrs[issued];
+        req.type = writes[issued] ? WRITE_ACCESS : read_ACCESS;
+        req.id = (uint32_t)issued;
+        req.push(this);
+        issue_time[issued++] = engine.getNow();
+        outstanding++;
+        engine.schedule(0, first_level, req);
+        if (issued < count && outstanding < window) scheduleIssue(engine, 1);
+    }
+};
+
+// The two-level hierarchy of TwoLevelCache as components
+struct EventHierarchy {
+    MemoryComponent memory;
+    CacheComponent l2;
+    CacheComponent l1;
+
+    EventHierarchy(int l1_line_size, const HierarchyConfig& config = HierarchyConfig(), int dram_occupancy = 0)
+        : memory(config.dram_penalty, dram_occupancy),
+          l2(config.l2_size, config.l2_line_size, config.l2_assoc, config.l2_hit_time, &memory, config.dram_penalty),
+          l1(config.l1_size, l1_line_size, config.l1_assoc, config.l1_hit_time, &l2, config.l2_hit_time) {}
+
+    // Functional warmup, as TwoLevelCache::warmAccess
+    void warm(unsigned long long addr, accessType type) {
+        Cache &c1 = l1.getCache(), &c2 = l2.getCache();
+        if (c1.warm(addr, type)) return;
+        if (c1.getDirtyVictim() != NO_VICTIM) c2.install<false>(c1.getDirtyVictim());
+        c2.warm(addr, read_ACCESS);
+    }
+};
+
+struct EventRunStats {
+    unsigned long long accesses = 0;
+    unsigned long long total_latency = 0;   // sum of per-access latencies
+    unsigned long long finish_time = 0;     // cycle of the last response
+    unsigned long long events = 0;
+    double seconds = 0;
+
+    double averageLatency() const { return accesses ? (double)total_latency / accesses : 0.0; }
+};
+
+// Run accesses through an event-driven hierarchy with up to `window`
+// outstanding. With window 1 every access completes before the next one is
+// issued, and the latencies equal TwoLevelCache::memoryAccess cycles. The
+// first `warmup` accesses only warm the caches and are not counted.
+inline EventRunStats runEventDriven(const unsigned long long *addrs, const unsigned char *writes, size_t n,
+                                    int l1_line_size, const HierarchyConfig& config, int window, int dram_occupancy = 0,
+                                    size_t warmup = 0) {
+    EventEngine engine;
+    EventHierarchy hierarchy(l1_line_size, config, dram_occupancy);
+    warmup = min(warmup, n);
+    for (size_t i = 0; i < warmup; i++) hierarchy.warm(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+    addrs += warmup;
+    writes += warmup;
+    n -= warmup;
+    AccessDriver driver(addrs, writes, n, window, &hierarchy.l1);
+    auto start = chrono::steady_clock::now();
+    driver.start(engine);
+    engine.run();
+    EventRunStats stats;
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats.accesses = n;
+    stats.total_latency = driver.getTotalLatency();
+    stats.finish_time = driver.getFinishTime();
+    stats.events = engine.getProcessed();
+    return stats;
+}
+
+// Out-of-order core timing over a program-order instruction stream. Each
+// instruction dispatches in order, at most issue_width per cycle, once its
+// ROB entry (and for memory operations its LSQ entry) is free; it completes
+// after its latency and retires in order, at most issue_width per cycle.
+// Non-memory instructions take one cycle and are independent. A load may
+// depend on the previous load (pointer chasing) and then starts when that
+// load completes, so independent misses overlap and dependent ones do not.
+// Stores retire after one cycle and drain from the LSQ in the background.
+// ROB and LSQ are rings of completion times, O(1) per instruction; the
+// misses in flight are a min-heap, O(log ROB) per miss.
+#define MLP_BUCKETS 7   // 1, 2, 3-4, 5-8, 9-16, 17-32, 33+
+
+class CoreModel {
+private:
+    vector<unsigned long long> rob;     // retire time, indexed by instruction
+    vector<unsigned long long> lsq;     // release time, indexed by memory op
+    size_t rob_pos = 0, lsq_pos = 0;
+    int width, miss_latency;
+    uint32_t dependency_threshold;
+    unsigned long long dispatch_cycle = 0, retire_cycle = 0, last_retire = 0, last_load_done = 0;
+    int dispatched = 0, retired = 0;
+    unsigned long long instructions = 0, misses = 0, mlp_sum = 0;
+    unsigned long long mlp[MLP_BUCKETS] = {};
+    priority_queue<unsigned long long, vector<unsigned long long>, greater<unsigned long long>> in_flight;
+
+    unsigned long long dispatch(unsigned long long ready) {
+        if (ready > dispatch_cycle) { dispatch_cycle = ready; dispatched = 0; }
+        unsigned long long d = dispatch_cycle;
+        if (++dispatched == width) { dispatch_cycle++; dispatched = 0; }
+        return d;
+    }
+
+    unsigned long long retire(unsigned long long done) {
+        done = max(done, last_retire);
+        if (done > retire_cycle) { retire_cycle = done; retired = 0; }
+        last_retire = retire_cycle;
+        if (++retired == width) { retire_cycle++; retired = 0; }
+        rob[rob_pos] = last_retire;
+        if (++rob_pos == rob.size()) rob_pos = 0;
+        instructions++;
+        return last_retire;
+    }
+
+    // Histogram of the misses in flight (including this one) as each starts
+    void recordMiss(unsigned long long start, unsigned long long end) {
+        while (!in_flight.empty() && in_flight.top() <= start) in_flight.pop();
+        in_flight.push(end);
+        size_t n = in_flight.size();
+        int bucket = n <= 2 ? (int)n - 1 : min(MLP_BUCKETS - 1, 64 - __builtin_clzll(n - 1));
+        mlp[bucket]++;
+        mlp_sum += n;
+        misses++;
+    }
+
+public:
+    // Accesses slower than missLatency (normally the L1 hit time) count as
+    // misses for the MLP histogram
+    CoreModel(const HierarchyConfig& config, int missLatency)
+        : rob(max(1, config.rob_size), 0), lsq(max(1, config.lsq_size), 0), width(max(1, config.issue_width)),
+          miss_latency(missLatency), dependency_threshold((uint32_t)(config.load_dependency * 0x7FFFFFFFu)) {}
+
+    void nonMemory() {
+        retire(dispatch(rob[rob_pos]) + 1);
+    }
+
+    // `draw` supplies the dependency decision (its low 31 bits)
+    void memory(bool write, int latency, uint32_t draw) {
+        unsigned long long d = dispatch(max(rob[rob_pos], lsq[lsq_pos]));
+        unsigned long long start = d, release;
+        if (write) {
+            release = max(retire(d + 1), d + latency);
+        } else {
+            if ((draw & 0x7FFFFFFFu) < dependency_threshold) start = max(start, last_load_done);
+            last_load_done = start + latency;
+            release = retire(last_load_done);
+        }
+        if (latency > miss_latency) recordMiss(start, start + latency);
+        lsq[lsq_pos] = release;
+        if (++lsq_pos == lsq.size()) lsq_pos = 0;
+    }
+
+    unsigned long long getInstructions() const { return instructions; }
+    unsigned long long getCycles() const { return last_retire; }
+    double getCPI() const { return instructions ? (double)last_retire / instructions : 0.0; }
+    unsigned long long getMisses() const { return misses; }
+    const unsigned long long* getMLPHistogram() const { return mlp; }
+
+    // Average misses in flight as seen by each miss
+    double getMeanMLP() const { return misses ? (double)mlp_sum / misses : 0.0; }
+};
+
+#endif // CACHESIM_ENGINE_H
@@ -1,244 +1,1463 @@
-#include <iostream>
-#include <iomanip>
-#include <vector>
-#include <cstdlib>
-#include <ctime>
-#include <string>
-using namespace std;
-
-#define DRAM_SIZE (64ULL * 1024 * 1024 * 1024)
-#define L1_CACHE_SIZE (16 * 1024)
-#define L2_CACHE_SIZE (128 * 1024)
-#define L1_ASSOCIATIVITY 4
-#define L2_ASSOCIATIVITY 8
-#define L2_LINE_SIZE 64
-#define NO_OF_ITERATIONS 1000000
-
-enum cacheResType { MISS = 0, HIT = 1 };
-enum accessType { read_ACCESS = 0, WRITE_ACCESS = 1 };
-
-// Custom random number generator
-unsigned int m_w = 0xABABAB55;
-unsigned int m_z = 0x05080902;
-
-void seed_random() {
-    unsigned int seed = (unsigned int)time(NULL);
-    m_w = seed ^ 0xABABAB55;
-    m_z = (seed >> 16) ^ 0x05080902;
-    if (m_w == 0) m_w = 0xABABAB55;
-    if (m_z == 0) m_z = 0x05080902;
+#include "cachesim_engine.h"
+#include "cachesim.h"
+#include "cachesim_c.h"
+#include <array>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <signal.h>
+#endif
+
+// SMARTS-style systematic sampling: the instruction stream is split into
+// equal periods, each ending in a measured unit of unit_size instructions
+// preceded by detailed_warmup unmeasured detailed instructions. The rest of
+// the period is functionally warmed (its last functional_warming
+// instructions) and skipped (anything before that).
+struct SamplingConfig {
+    unsigned long long total_instructions = NO_OF_ITERATIONS;
+    unsigned long long unit_size = 1000;
+    unsigned long long detailed_warmup = 2000;
+    unsigned long long functional_warming = 100000;
+    int initial_samples = 100;
+    int max_rounds = 4;
+    double target_error = 0.03;     // relative CI half-width
+    double confidence_z = 1.96;     // 95% confidence
+};
+
+struct SampledResult {
+    double cpi = 0.0;
+    double ci_half_width = 0.0;
+    double relative_error = 0.0;
+    int samples = 0;
+    int rounds = 0;
+};
+
+// Warmup argument of run()/runOn() meaning "config.warmup"
+#define CONFIG_WARMUP (~0ULL)
+
+// Design-space exploration. Every point is a hierarchy configuration plus
+// an L1 line size; its cost is the storage area of both levels (data plus
+// tag, valid and dirty bits for the DRAM_SIZE address space).
+#define DSE_RUNGS 3
+#define DSE_ETA 4       // budget growth and survivor reduction per rung
+
+struct DesignPoint {
+    HierarchyConfig config;
+    int l1_line_size = 64;
+    double cpi = 0.0;
+    double area_kb = 0.0;
+};
+
+double cacheAreaKB(int size, int line_size, int associativity) {
+    int lines = size / line_size;
+    int address_bits = (int)ceil(log2((double)DRAM_SIZE));
+    int index_bits = (int)ceil(log2((double)(lines / associativity))) + (int)ceil(log2((double)line_size));
+    return (size + lines * (address_bits - index_bits + 2) / 8.0) / 1024.0;
 }
 
-unsigned int rand_() {
-    m_z = 36969 * (m_z & 65535) + (m_z >> 16);
-    m_w = 18000 * (m_w & 65535) + (m_w >> 16);
-    return (m_z << 16) + m_w;
+bool dominates(const DesignPoint& a, const DesignPoint& b) {
+    return a.cpi <= b.cpi && a.area_kb <= b.area_kb && (a.cpi < b.cpi || a.area_kb < b.area_kb);
 }
 
-// Memory generators
-unsigned int memGen1() { static unsigned int addr = 0; return (addr++) % DRAM_SIZE; }
-unsigned int memGen2() { return rand_() % (24 * 1024); }
-unsigned int memGen3() { return rand_() % DRAM_SIZE; }
-unsigned int memGen4() { static unsigned int addr = 0; return (addr++) % (4 * 1024); }
-unsigned int memGen5() { static unsigned int addr = 0; return (addr += 32) % (64 * 16 * 1024); }
-
-struct CacheLine {
-    bool valid = false;
-    unsigned long long tag = 0;
-    bool dirty = false;
-};
+// Non-dominated sorting: rank 0 is the Pareto frontier, rank 1 the
+// frontier once rank 0 is removed, and so on
+vector<int> paretoRanks(const vector<DesignPoint>& points) {
+    vector<int> rank(points.size(), -1);
+    size_t ranked = 0;
+    for (int r = 0; ranked < points.size(); r++) {
+        vector<size_t> layer;
+        for (size_t i = 0; i < points.size(); i++) {
+            if (rank[i] >= 0) continue;
+            bool dominated = false;
+            for (size_t j = 0; j < points.size() && !dominated; j++) {
+                dominated = j != i && (rank[j] < 0 || rank[j] == r) && dominates(points[j], points[i]);
+            }
+            if (!dominated) layer.push_back(i);
+        }
+        for (size_t i : layer) rank[i] = r;
+        ranked += layer.size();
+    }
+    return rank;
+}
 
-class Cache {
+// Parameter ranges ("key=v1,v2,...") over HierarchyConfig keys and l1_line.
+// Unset keys keep the base configuration's value.
+class DesignSpace {
 private:
-    vector<vector<CacheLine>> cache;
-    int cache_size, line_size, associativity, num_sets, hit_time;
-    mutable unsigned long long hits = 0;
-    mutable unsigned long long misses = 0;
-    mutable unsigned long long writebacks = 0;
+    vector<pair<string, vector<string>>> ranges;
 
 public:
-    Cache(int size, int lineSize, int assoc, int hitTime)
-        : cache_size(size), line_size(lineSize), associativity(assoc), hit_time(hitTime) {
-        num_sets = cache_size / (line_size * associativity);
-        cache.resize(num_sets, vector<CacheLine>(associativity));
-    }
-
-    int getHitTime() const { return hit_time; }
-    int getCacheSize() const { return cache_size; }
-    int getLineSize() const { return line_size; }
-    int getAssociativity() const { return associativity; }
-    int getNumSets() const { return num_sets; }
-
-    unsigned long long getHits() const { return hits; }
-    unsigned long long getMisses() const { return misses; }
-    unsigned long long getWritebacks() const { return writebacks; }
-    double getHitRate() const {
-        unsigned long long total = hits + misses;
-        return total > 0 ? (double)hits / total : 0.0;
-    }
-    void resetStats() { hits = misses = writebacks = 0; }
-
-    pair<cacheResType, bool> access(unsigned long long addr, accessType type) {
-        unsigned long long block_addr = addr / line_size;
-        unsigned int set_index = block_addr % num_sets;
-        unsigned long long tag = block_addr / num_sets;
-
-        // Check for hit
-        for (int way = 0; way < associativity; way++) {
-            if (cache[set_index][way].valid && cache[set_index][way].tag == tag) {
-                hits++;
-                if (type == WRITE_ACCESS) cache[set_index][way].dirty = true;
-                return {HIT, false};
-            }
-        }
-
-        // Miss occurred
-        misses++;
-        int replace_way = -1;
-        bool writeback = false;
-
-        // Find empty way first
-        for (int way = 0; way < associativity; way++) {
-            if (!cache[set_index][way].valid) {
-                replace_way = way;
-                break;
-            }
+    bool setRange(const string& assignment) {
+        size_t eq = assignment.find('=');
+        if (eq == string::npos || eq + 1 == assignment.size()) return false;
+        string key = assignment.substr(0, eq);
+        HierarchyConfig probe;
+        vector<string> values;
+        stringstream list(assignment.substr(eq + 1));
+        string value;
+        while (getline(list, value, ',')) {
+            bool ok = key == "l1_line" ? atoi(value.c_str()) > 0 : probe.set(key, value);
+            if (!ok || key == "iterations" || key == "mem_ratio") return false;
+            values.push_back(value);
         }
+        for (auto& r : ranges) {
+            if (r.first == key) { r.second = values; return true; }
+        }
+        ranges.push_back({key, values});
+        return true;
+    }
 
-        // If no empty way, use random replacement
-        if (replace_way == -1) {
-            replace_way = rand_() % associativity;
-            if (cache[set_index][replace_way].dirty) {
-                writeback = true;
-                writebacks++;
+    bool empty() const { return ranges.empty(); }
+
+    // Cartesian product of the ranges; invalid geometries are dropped
+    vector<DesignPoint> expand(const HierarchyConfig& base, int base_line, int& invalid) const {
+        vector<DesignPoint> points;
+        vector<size_t> index(ranges.size(), 0);
+        invalid = 0;
+        while (true) {
+            DesignPoint p;
+            p.config = base;
+            p.l1_line_size = base_line;
+            for (size_t k = 0; k < ranges.size(); k++) {
+                const string& value = ranges[k].second[index[k]];
+                if (ranges[k].first == "l1_line") p.l1_line_size = atoi(value.c_str());
+                else p.config.set(ranges[k].first, value);
+            }
+            string error;
+            if (p.config.validate({p.l1_line_size}, error)) {
+                p.area_kb = cacheAreaKB(p.config.l1_size, p.l1_line_size, p.config.l1_assoc) +
+                            cacheAreaKB(p.config.l2_size, p.config.l2_line_size, p.config.l2_assoc);
+                points.push_back(p);
+            } else {
+                invalid++;
             }
+            size_t k = 0;
+            while (k < ranges.size() && ++index[k] == ranges[k].second.size()) index[k++] = 0;
+            if (k == ranges.size()) break;
         }
-
-        cache[set_index][replace_way].valid = true;
-        cache[set_index][replace_way].tag = tag;
-        cache[set_index][replace_way].dirty = (type == WRITE_ACCESS);
-        return {MISS, writeback};
+        return points;
     }
 
-    void reset() {
-        for (auto &set : cache)
-            for (auto &line : set)
-                line = {};
-        resetStats();
+    static DesignSpace defaults() {
+        DesignSpace space;
+        space.setRange("l1_size=8192,16384,32768,65536");
+        space.setRange("l1_assoc=1,2,4,8");
+        space.setRange("l1_line=16,32,64,128");
+        space.setRange("l2_size=65536,131072,262144,524288");
+        space.setRange("l2_assoc=4,8,16");
+        return space;
     }
 };
 
-class TwoLevelCache {
-private:
-    Cache *l1_cache, *l2_cache;
-    int dram_penalty;
-    mutable unsigned long long total_accesses = 0;
-    mutable unsigned long long total_cycles = 0;
+struct DseResult {
+    vector<DesignPoint> frontier;           // sorted by area
+    vector<pair<size_t, unsigned long long>> rungs;   // points and instructions per point
+    int invalid = 0;
+    unsigned long long simulated_instructions = 0;
+};
 
-public:
-    TwoLevelCache(int l1_line_size) : dram_penalty(50) {
-        l1_cache = new Cache(L1_CACHE_SIZE, l1_line_size, L1_ASSOCIATIVITY, 1);
-        l2_cache = new Cache(L2_CACHE_SIZE, L2_LINE_SIZE, L2_ASSOCIATIVITY, 10);
-    }
-    ~TwoLevelCache() { delete l1_cache; delete l2_cache; }
+// Monte Carlo replicates of a grid point. Replicate r of (generator, line
+// size) draws the stream derive_seed(master, generator, line, r), so
+// replicate 0 is the single-run value. With a target half-width,
+// replicates stop once the 95% CI is narrower than it (after at least
+// min_replicates); otherwise exactly max_replicates are run.
+struct ReplicateConfig {
+    int min_replicates = 3;
+    int max_replicates = 1;
+    double target_half_width = 0.0;     // CPI; 0 disables early stopping
+};
 
-    void reset() {
-        l1_cache->reset();
-        l2_cache->reset();
-        total_accesses = total_cycles = 0;
+// Two-sided 95% Student t critical values
+double tCritical95(int dof) {
+    static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                     2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                     2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (dof < 1) return 0.0;
+    if (dof <= 30) return table[dof - 1];
+    if (dof <= 40) return 2.021;
+    if (dof <= 60) return 2.000;
+    if (dof <= 120) return 1.980;
+    return 1.960;
+}
+
+struct ReplicateStats {
+    double mean = 0.0;
+    double stddev = 0.0;
+    double ci_half_width = 0.0;
+    int replicates = 0;
+
+    static ReplicateStats of(const double *values, int n) {
+        ReplicateStats st;
+        st.replicates = n;
+        for (int i = 0; i < n; i++) st.mean += values[i];
+        st.mean /= max(n, 1);
+        if (n < 2) return st;
+        double var = 0.0;
+        for (int i = 0; i < n; i++) var += (values[i] - st.mean) * (values[i] - st.mean);
+        st.stddev = sqrt(var / (n - 1));
+        st.ci_half_width = tCritical95(n - 1) * st.stddev / sqrt((double)n);
+        return st;
     }
+};
 
-    Cache* getL1Cache() const { return l1_cache; }
-    Cache* getL2Cache() const { return l2_cache; }
+// Multi-process sweeps: the launcher maps a results table shared with its
+// forked workers. A slot's state is SLOT_FREE, the pid of the worker that
+// claimed it (set with one compare-and-swap), SLOT_DONE or SLOT_FAILED.
+// Slots held by a worker that dies are freed again, up to
+// FORK_MAX_ATTEMPTS attempts per slot.
+#define SLOT_FREE 0
+#define SLOT_DONE -1
+#define SLOT_FAILED -2
+#define FORK_MAX_ATTEMPTS 3
+
+struct SharedResultSlot {
+    atomic<int> state;
+    int attempts;
+    double cpi;
+};
 
-    double getAverageAccessTime() const {
-        return total_accesses > 0 ? (double)total_cycles / total_accesses : 0.0;
-    }
+struct ForkStats {
+    int workers_started = 0;
+    int crashes = 0;
+    int failed_slots = 0;
+};
 
-    int memoryAccess(unsigned long long addr, accessType type) {
-        total_accesses++;
-        int cycles = 0;
+class CacheSimulator {
+private:
+    unsigned long long master_seed;
+    bool pipelined = false;
+    int shards = 1;
+    int event_window = 0;
+    HierarchyConfig config;
+    EnergyModel energy;
+    function<void(int, int)> fork_point_hook;     // (slot, attempt), in the worker
 
-        // Always pay L1 access time
-        cycles += l1_cache->getHitTime();
-        auto l1_result = l1_cache->access(addr, type);
+public:
+    CacheSimulator(unsigned long long seed = time_seed()) : master_seed(seed) {}
+
+    unsigned long long getMasterSeed() const { return master_seed; }
+    void setPipelined(bool enabled) { pipelined = enabled; }
+    void setConfig(const HierarchyConfig& c) { config = c; }
+    void setEnergyModel(const EnergyModel& model) { energy = model; }
+    void setShards(int n) { shards = max(1, n); }
+    void setEventWindow(int n) { event_window = max(0, n); }
+    // Called in a forked worker before it computes a grid point
+    void setForkPointHook(function<void(int, int)> hook) { fork_point_hook = std::move(hook); }
+    const HierarchyConfig& getConfig() const { return config; }
+
+    // Default grid: the five memGen patterns followed by the extended
+    // workload library at footprints well beyond L2
+    vector<unique_ptr<WorkloadGenerator>> defaultWorkloads() {
+        vector<unique_ptr<WorkloadGenerator>> workloads;
+        workloads.push_back(make_unique<BulkWorkload>("memGen1", bulkGen1));
+        workloads.push_back(make_unique<BulkWorkload>("memGen2", bulkGen2));
+        workloads.push_back(make_unique<BulkWorkload>("memGen3", bulkGen3));
+        workloads.push_back(make_unique<BulkWorkload>("memGen4", bulkGen4));
+        workloads.push_back(make_unique<BulkWorkload>("memGen5", bulkGen5));
+        workloads.push_back(make_unique<PointerChaseGenerator>(16 * 1024 * 1024, 64, 2));
+        workloads.push_back(make_unique<TiledMatmulGenerator>(256, 32));
+        workloads.push_back(make_unique<StencilGenerator>(1024, 1024));
+        workloads.push_back(make_unique<StencilGenerator>(128, 128, 128));
+        workloads.push_back(make_unique<HashProbeGenerator>(64 * 1024 * 1024, 16, 2));
+        workloads.push_back(make_unique<ZipfGenerator>(DRAM_SIZE, 64, 0.99));
+        workloads.push_back(make_unique<HotColdGenerator>(DRAM_SIZE, 64, 64 * 1024, 0.9));
+        return workloads;
+    }
 
-        if (l1_result.first == HIT) {
-            total_cycles += cycles;
-            return cycles;
+    void runSimulations() {
+        auto workloads = defaultWorkloads();
+        int line_sizes[] = {16, 32, 64, 128};
+        vector<vector<double>> cpi(workloads.size(), vector<double>(4));
+        PipelineStats pipeline_stats;
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            for (int l = 0; l < 4; l++) cpi[g][l] = runGridPoint(*workloads[g], g, line_sizes[l], pipeline_stats);
         }
+        printSimulationResults(workloads, cpi, pipelined ? &pipeline_stats : nullptr);
+    }
 
-        // L1 miss - handle writeback if needed
-        if (l1_result.second) {
-            cycles += l2_cache->getHitTime();
+    // runSimulations() with the grid points computed by `workers` forked
+    // processes. Prints exactly the same table; crashes are reported on
+    // stderr. Returns false if a point failed on every attempt.
+    bool runForkedSimulations(int workers) {
+        auto workloads = defaultWorkloads();
+        vector<vector<double>> cpi(workloads.size(), vector<double>(4));
+        ForkStats stats;
+        bool ok = runForkedGrid(workers, cpi, stats);
+        if (stats.crashes) {
+            cerr << stats.crashes << " worker crash(es), " << stats.workers_started << " workers started, "
+                 << stats.failed_slots << " point(s) failed\n";
         }
+        if (!ok) return false;
+        printSimulationResults(workloads, cpi, nullptr);
+        return true;
+    }
 
-        // Access L2
-        cycles += l2_cache->getHitTime();
-        auto l2_result = l2_cache->access(addr, read_ACCESS);
-
-        if (l2_result.first == HIT) {
-            total_cycles += cycles;
-            return cycles;
+    // Fill cpi[g][l] for the default grid from forked worker processes
+    bool runForkedGrid(int workers, vector<vector<double>>& cpi, ForkStats& stats) {
+        int line_sizes[] = {16, 32, 64, 128};
+        int num_slots = (int)cpi.size() * 4;
+#ifdef _WIN32
+        // No fork(): compute in-process
+        PipelineStats unused;
+        auto workloads = defaultWorkloads();
+        for (int i = 0; i < num_slots; i++) cpi[i / 4][i % 4] = runGridPoint(*workloads[i / 4], i / 4, line_sizes[i % 4], unused);
+        return true;
+#else
+        size_t bytes = sizeof(SharedResultSlot) * num_slots;
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        SharedResultSlot *slots = (SharedResultSlot*)mem;
+        for (int i = 0; i < num_slots; i++) {
+            new (&slots[i].state) atomic<int>(SLOT_FREE);
+            slots[i].attempts = 0;
+            slots[i].cpi = 0.0;
         }
 
-        // L2 miss - access DRAM
-        cycles += dram_penalty;
+        auto worker = [&]() {
+            bool saved_pipelined = pipelined;
+            pipelined = false;
+            auto workloads = defaultWorkloads();
+            PipelineStats unused;
+            int pid = (int)getpid();
+            for (int i = 0; i < num_slots; i++) {
+                int expected = SLOT_FREE;
+                if (!slots[i].state.compare_exchange_strong(expected, pid)) continue;
+                if (fork_point_hook) fork_point_hook(i, slots[i].attempts);
+                slots[i].cpi = runGridPoint(*workloads[i / 4], i / 4, line_sizes[i % 4], unused);
+                slots[i].state.store(SLOT_DONE, memory_order_release);
+            }
+            pipelined = saved_pipelined;
+        };
+        auto has_free_slot = [&]() {
+            for (int i = 0; i < num_slots; i++) {
+                if (slots[i].state.load() == SLOT_FREE) return true;
+            }
+            return false;
+        };
+        auto spawn = [&]() {
+            cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                worker();
+                _exit(0);
+            }
+            if (pid > 0) stats.workers_started++;
+            return pid > 0;
+        };
+
+        int alive = 0;
+        for (int w = 0; w < max(1, min(workers, num_slots)); w++) alive += spawn();
+        while (alive > 0) {
+            int status;
+            pid_t pid = wait(&status);
+            if (pid < 0) break;
+            alive--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                stats.crashes++;
+                for (int i = 0; i < num_slots; i++) {
+                    if (slots[i].state.load() != pid) continue;
+                    slots[i].attempts++;
+                    slots[i].state.store(slots[i].attempts >= FORK_MAX_ATTEMPTS ? SLOT_FAILED : SLOT_FREE);
+                }
+            }
+            while (alive < workers && has_free_slot() && spawn()) alive++;
+        }
 
-        // Handle L2 writeback if needed
-        if (l2_result.second) {
-            cycles += dram_penalty;
+        bool ok = true;
+        for (int i = 0; i < num_slots; i++) {
+            if (slots[i].state.load() == SLOT_DONE) {
+                cpi[i / 4][i % 4] = slots[i].cpi;
+            } else {
+                stats.failed_slots++;
+                ok = false;
+            }
         }
+        munmap(mem, bytes);
+        return ok;
+#endif
+    }
 
-        total_cycles += cycles;
-        return cycles;
+    // One point of the default grid, on its own seeded stream
+    double runGridPoint(WorkloadGenerator& gen, int g, int l1_line_size, PipelineStats& pipeline_stats) {
+        seed_stream(master_seed, g, l1_line_size, 0);
+        return pipelined ? runPipelined(gen, l1_line_size, pipeline_stats) : run(gen, l1_line_size);
     }
-};
 
-class CacheSimulator {
-public:
-    void runSimulations() {
-        seed_random();
-        unsigned int (*generators[])() = {memGen1, memGen2, memGen3, memGen4, memGen5};
-        string gen_names[] = {"memGen1", "memGen2", "memGen3", "memGen4", "memGen5"};
+    // Host memory per configuration of the grid, with line metadata
+    // packed at sizeof(CacheLine) bytes per line
+    void printMemoryReport() {
         int line_sizes[] = {16, 32, 64, 128};
+        TwoLevelCache probe(line_sizes[0], config);
+        cout << "Simulator memory (" << sizeof(CacheLine) << " B/line, L1/L2 tags " << probe.getL1Cache()->getTagBits()
+             << "/" << probe.getL2Cache()->getTagBits() << " bits):";
+        for (int l = 0; l < 4; l++) {
+            TwoLevelCache cache(line_sizes[l], config);
+            cout << " " << line_sizes[l] << "B " << fixed << setprecision(1) << cache.memoryBytes() / 1024.0 << " KB"
+                 << (l < 3 ? "," : "\n");
+        }
+    }
+
+    void printPipelineStats(const PipelineStats& stats) {
+        cout << "\nPipeline: " << stats.batches << " batches, producer stalls "
+             << stats.producer_stalls << " (" << fixed << setprecision(1) << stats.producer_stall_ms
+             << " ms), consumer stalls " << stats.consumer_stalls << " ("
+             << stats.consumer_stall_ms << " ms)\n";
+    }
 
+    void printSimulationResults(const vector<unique_ptr<WorkloadGenerator>>& workloads,
+                                const vector<vector<double>>& cpi, const PipelineStats *pipeline_stats) {
         cout << "\n" << string(70, '=') << "\n";
         cout << "                    CACHE SIMULATION RESULTS\n";
         cout << string(70, '=') << "\n";
+        cout << "Master seed: " << master_seed << "\n";
+        cout << "Hierarchy: ";
+        config.print(cout);
+        cout << "\n";
+        printMemoryReport();
 
         cout << "\n+------------+------------+------------+------------+------------+\n";
         cout << "| Generator  |   16B Line |   32B Line |   64B Line |  128B Line |\n";
         cout << "+------------+------------+------------+------------+------------+\n";
-
-        for (int g = 0; g < 5; g++) {
-            cout << "| " << setw(10) << gen_names[g] << " ";
-            for (int l = 0; l < 4; l++) {
-                double cpi = run(generators[g], line_sizes[l]);
-                cout << "| " << setw(10) << fixed << setprecision(4) << cpi << " ";
-            }
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            cout << "| " << setw(10) << workloads[g]->name() << " ";
+            for (int l = 0; l < 4; l++) cout << "| " << setw(10) << fixed << setprecision(4) << cpi[g][l] << " ";
             cout << "|\n";
         }
         cout << "+------------+------------+------------+------------+------------+\n";
 
+        if (pipeline_stats) printPipelineStats(*pipeline_stats);
+
         cout << "\nCPI Calculation Explanation:\n";
-        cout << "- Total iterations: " << NO_OF_ITERATIONS << "\n";
-        cout << "- Memory access probability: 35%\n";
-        cout << "- Expected memory accesses per run: ~" << (int)(NO_OF_ITERATIONS * 0.35) << "\n";
+        cout << "- Total iterations: " << config.iterations << "\n";
+        cout << "- Memory access probability: " << setprecision(0) << 100 * config.mem_ratio << "%\n";
+        cout << "- Expected memory accesses per run: ~" << (unsigned long long)(config.iterations * config.mem_ratio) << "\n";
         cout << "- Non-memory instructions: 1 cycle each\n";
         cout << "- Memory access cycles vary based on cache hits/misses\n";
         cout << "- CPI = Total Cycles / Total Instructions\n";
     }
 
-    double run(unsigned int (*gen)(), int l1_line_size) {
-        TwoLevelCache cache(l1_line_size);
+    // Sweep the Zipf exponent over a fixed footprint to find where L2 stops
+    // absorbing the hot set
+    void runZipfSweep(unsigned long long footprint = DRAM_SIZE, int l1_line_size = 64) {
+        double thetas[] = {0.5, 0.7, 0.8, 0.9, 0.99, 1.1, 1.2, 1.5};
+
+        cout << "\nZipf sweep over " << (footprint >> 20) << "MB, 64B items, "
+             << l1_line_size << "B L1 lines (master seed " << master_seed << ")\n";
+        cout << "+--------+------------+------------+------------+\n";
+        cout << "| Theta  |        CPI |  L1 Hit %  |  L2 Hit %  |\n";
+        cout << "+--------+------------+------------+------------+\n";
+        for (int t = 0; t < 8; t++) {
+            ZipfGenerator zipf(footprint, 64, thetas[t]);
+            TwoLevelCache cache(l1_line_size, config);
+            seed_stream(master_seed, 100 + t, l1_line_size, 0);
+            double cpi = runOn(zipf, cache, config.iterations / 2);
+            cout << "| " << setw(6) << fixed << setprecision(2) << thetas[t] << " "
+                 << "| " << setw(10) << setprecision(4) << cpi << " "
+                 << "| " << setw(10) << setprecision(2) << 100.0 * cache.getL1Cache()->getHitRate() << " "
+                 << "| " << setw(10) << 100.0 * cache.getL2Cache()->getHitRate() << " |\n";
+        }
+        cout << "+--------+------------+------------+------------+\n";
+    }
+
+    // runBlocks with an instruction fetch before every instruction; the
+    // fetch stalls are added to the data-side cycles
+    unsigned long long runBlocksFetch(WorkloadGenerator& gen, WorkloadGenerator& code, SplitL1Hierarchy& cache,
+                                      LaneRng& rng, LaneRng& code_rng, unsigned long long instructions) {
+        uint32_t draws[BULK_BLOCK];
+        unsigned long long addrs[BULK_BLOCK], pcs[BULK_BLOCK];
+        unsigned char is_mem[BULK_BLOCK];
+        unsigned long long total_cycles = 0;
+        const uint32_t threshold = config.memThreshold();
+        while (instructions > 0) {
+            int n = instructions < BULK_BLOCK ? (int)instructions : BULK_BLOCK;
+            rng.fill(draws, n);
+            int mem = 0;
+            for (int i = 0; i < n; i++) mem += (is_mem[i] = draws[i] <= threshold);
+            rng.fill(draws, mem);
+            gen.fill(addrs, mem, rng);
+            code.fill(pcs, n, code_rng);
+            for (int i = 0, m = 0; i < n; i++) {
+                total_cycles += cache.fetch(pcs[i]);
+                if (!is_mem[i]) {
+                    total_cycles++;
+                    continue;
+                }
+                total_cycles += cache.memoryAccess(addrs[m], (draws[m] >> 31) ? WRITE_ACCESS : read_ACCESS);
+                m++;
+            }
+            instructions -= n;
+        }
+        return total_cycles;
+    }
+
+    struct FetchResult {
+        double cpi = 0, cpi_no_fetch = 0;
+        double l1i_mpki = 0, l2_inst_mpki = 0, l2_data_mpki = 0;
+        double data_on_inst = 0, inst_on_data = 0;      // extra shared-L2 MPKI
+    };
+
+    // One workload with a code footprint at 64B L1D lines. The data stream
+    // is the one run() sees; the code stream has its own derived seed.
+    FetchResult runFetch(WorkloadGenerator& gen, int g, unsigned long long code_footprint) {
+        FetchResult r;
+        seed_stream(master_seed, g, 64, 0);
+        r.cpi_no_fetch = run(gen, 64, 0);
+        seed_stream(master_seed, g, 64, 0);
+        SplitL1Hierarchy cache(64, config);
+        CodeWalkGenerator code(code_footprint);
+        LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+        LaneRng code_rng(derive_seed(master_seed, g, L1I_LINE_SIZE, 1));
+        gen.reset();
+        unsigned long long cycles = runBlocksFetch(gen, code, cache, rng, code_rng, config.iterations);
+        double kilo = config.iterations / 1000.0;
+        r.cpi = (double)cycles / config.iterations;
+        r.l1i_mpki = cache.getL1ICache().getMisses() / kilo;
+        r.l2_inst_mpki = cache.l2_inst_misses / kilo;
+        r.l2_data_mpki = cache.l2_data_misses / kilo;
+        r.data_on_inst = ((double)cache.l2_inst_misses - (double)cache.getL2InstMissesAlone()) / kilo;
+        r.inst_on_data = ((double)cache.l2_data_misses - (double)cache.getL2DataMissesAlone()) / kilo;
+        return r;
+    }
+
+    // The workloads with an instruction-fetch stream over a shared L2
+    void runFetchSimulations(unsigned long long code_footprint) {
+        auto workloads = defaultWorkloads();
+        cout << "\nInstruction fetch: " << (code_footprint >> 10) << "KB code, L1I " << HierarchyConfig::sizeText(config.l1i_size) << " "
+             << config.l1i_assoc << "-way " << L1I_LINE_SIZE << "B, 64B L1D lines (master seed " << master_seed << ")\nHierarchy: ";
+        config.print(cout);
+        cout << "\nMPKI = misses per 1000 instructions. L2 I/D are shared-L2 MPKI per side; D->I and I->D are\n"
+             << "the extra shared-L2 MPKI each side causes the other, against an L2 of its own\n";
+        cout << "+------------+----------+----------+----------+----------+----------+----------+----------+\n";
+        cout << "| Generator  |      CPI |   +Fetch | L1I MPKI |   L2 I   |   L2 D   |   D->I   |   I->D   |\n";
+        cout << "+------------+----------+----------+----------+----------+----------+----------+----------+\n";
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            FetchResult r = runFetch(*workloads[g], g, code_footprint);
+            cout << "| " << setw(10) << workloads[g]->name() << " " << fixed << setprecision(3);
+            for (double v : {r.cpi_no_fetch, r.cpi, r.l1i_mpki, r.l2_inst_mpki, r.l2_data_mpki, r.data_on_inst, r.inst_on_data}) {
+                cout << "| " << setw(8) << v << " ";
+            }
+            cout << "|\n";
+        }
+        cout << "+------------+----------+----------+----------+----------+----------+----------+----------+\n";
+    }
+
+    // One row per workload, one column per swept L1 line size
+    void printLineTable(const string& title, const vector<unique_ptr<WorkloadGenerator>>& workloads,
+                        const vector<vector<double>>& values) const {
+        cout << "\n" << title << "\n";
+        cout << "+------------+------------+------------+------------+------------+\n";
+        cout << "| Generator  |   16B Line |   32B Line |   64B Line |  128B Line |\n";
+        cout << "+------------+------------+------------+------------+------------+\n";
+        for (size_t g = 0; g < workloads.size(); g++) {
+            cout << "| " << setw(10) << workloads[g]->name() << " ";
+            for (int l = 0; l < 4; l++) cout << "| " << setw(10) << fixed << setprecision(4) << values[g][l] << " ";
+            cout << "|\n";
+        }
+        cout << "+------------+------------+------------+------------+------------+\n";
+    }
+
+    // CPI and bytes moved per instruction across each link for the grid,
+    // with the tag/state storage each L1 line size costs, so sectored and
+    // whole-line configurations can be compared. Links with a bandwidth
+    // limit also report their utilization.
+    void runTrafficSimulations() {
+        int line_sizes[] = {16, 32, 64, 128};
+        const int address_bits = 36;        // DRAM_SIZE
+        auto workloads = defaultWorkloads();
+        size_t rows = workloads.size();
+        vector<vector<double>> cpi(rows, vector<double>(4)), l1_l2(rows, vector<double>(4)), l2_dram(rows, vector<double>(4));
+        vector<vector<double>> l2_util(rows, vector<double>(4)), dram_util(rows, vector<double>(4));
+        double l1_meta[4], l2_meta = 0;
+        for (int g = 0; g < (int)rows; g++) {
+            for (int l = 0; l < 4; l++) {
+                seed_stream(master_seed, g, line_sizes[l], 0);
+                TwoLevelCache cache(line_sizes[l], config);
+                cpi[g][l] = runOn(*workloads[g], cache);
+                const Cache &l1 = *cache.getL1Cache(), &l2 = *cache.getL2Cache();
+                l1_l2[g][l] = (double)(l1.getFillBytes() + l1.getWritebackBytes()) / config.iterations;
+                l2_dram[g][l] = (double)(l2.getFillBytes() + l2.getWritebackBytes()) / config.iterations;
+                l2_util[g][l] = 100.0 * cache.linkUtilization(cache.getL2Link());
+                dram_util[g][l] = 100.0 * cache.linkUtilization(cache.getDramLink());
+                l1_meta[l] = l1.metadataBits(address_bits) / 8192.0;
+                l2_meta = l2.metadataBits(address_bits) / 8192.0;
+            }
+        }
+
+        cout << "\nTraffic (master seed " << master_seed << ")\nHierarchy: ";
+        config.print(cout);
+        cout << "\nTag/state storage: L1";
+        for (int l = 0; l < 4; l++) cout << " " << line_sizes[l] << "B " << fixed << setprecision(2) << l1_meta[l] << " KB";
+        cout << ", L2 " << l2_meta << " KB\n";
+        printLineTable("CPI", workloads, cpi);
+        printLineTable("L1 <-> L2 bytes per instruction (fills + writebacks)", workloads, l1_l2);
+        printLineTable("L2 <-> DRAM bytes per instruction (fills + writebacks)", workloads, l2_dram);
+        if (config.l2_bandwidth > 0) printLineTable("L1 <-> L2 link utilization (%)", workloads, l2_util);
+        if (config.dram_bandwidth > 0) printLineTable("L2 <-> DRAM link utilization (%)", workloads, dram_util);
+    }
+
+    // Sampled CPI of the grid: config.iterations instructions per point,
+    // measured in SMARTS units until the CI reaches target_error
+    bool runSampledSimulations(double target_error) {
+        int line_sizes[] = {16, 32, 64, 128};
+        auto workloads = defaultWorkloads();
+        size_t rows = workloads.size();
+        vector<vector<double>> cpi(rows, vector<double>(4)), error(rows, vector<double>(4)), samples(rows, vector<double>(4));
+        SamplingConfig cfg;
+        cfg.total_instructions = config.iterations;
+        cfg.target_error = target_error;
+        for (int g = 0; g < (int)rows; g++) {
+            for (int l = 0; l < 4; l++) {
+                seed_stream(master_seed, g, line_sizes[l], 0);
+                SampledResult r = runSampled(*workloads[g], line_sizes[l], cfg);
+                if (r.samples == 0) {
+                    cout << "Sampling needs iterations >= " << 2 * (cfg.unit_size + cfg.detailed_warmup) << "\n";
+                    return false;
+                }
+                cpi[g][l] = r.cpi;
+                error[g][l] = 100.0 * r.relative_error;
+                samples[g][l] = r.samples;
+            }
+        }
+
+        cout << "\nSampled CPI (master seed " << master_seed << ", target error " << 100.0 * target_error << "%)\nHierarchy: ";
+        config.print(cout);
+        cout << "\n";
+        printLineTable("CPI", workloads, cpi);
+        printLineTable("95% CI half-width (% of CPI)", workloads, error);
+        printLineTable("Samples", workloads, samples);
+        return true;
+    }
+
+    // CPI, energy and energy-delay product per instruction for the grid.
+    // Energy comes from the counters the timed run leaves in the hierarchy,
+    // so it needs no second pass; EDP is pJ per instruction times ns per
+    // instruction at clock_ghz.
+    void runEnergySimulations() {
+        int line_sizes[] = {16, 32, 64, 128};
+        auto workloads = defaultWorkloads();
+        size_t rows = workloads.size();
+        vector<vector<double>> cpi(rows, vector<double>(4)), pj(rows, vector<double>(4)), edp(rows, vector<double>(4));
+        vector<EnergyBreakdown> at64(rows);
+        for (int g = 0; g < (int)rows; g++) {
+            for (int l = 0; l < 4; l++) {
+                seed_stream(master_seed, g, line_sizes[l], 0);
+                TwoLevelCache cache(line_sizes[l], config);
+                cpi[g][l] = runOn(*workloads[g], cache);
+                EnergyBreakdown e = energy.measure(cache, config.clock_ghz);
+                pj[g][l] = e.total() / config.iterations;
+                edp[g][l] = pj[g][l] * cpi[g][l] / config.clock_ghz;
+                if (line_sizes[l] == 64) at64[g] = e;
+            }
+        }
+
+        cout << "\nEnergy (master seed " << master_seed << ")\nHierarchy: ";
+        config.print(cout);
+        const DramEnergy& d = energy.getDram();
+        cout << "\nDRAM: activate " << fixed << setprecision(0) << d.activate << " pJ, read " << d.read << " pJ, write "
+             << d.write << " pJ per 64B; clock " << setprecision(2) << config.clock_ghz << " GHz\n";
+        printLineTable("CPI", workloads, cpi);
+        printLineTable("Energy per instruction (pJ)", workloads, pj);
+        printLineTable("EDP per instruction (pJ x ns)", workloads, edp);
+
+        cout << "\nEnergy breakdown at 64B lines (pJ per instruction)\n";
+        cout << "+------------+--------+----------+----------+----------+----------+----------+----------+\n";
+        cout << "| Generator  |    CPI |       L1 |       L2 |     DRAM |  Leakage |    Total |      EDP |\n";
+        cout << "+------------+--------+----------+----------+----------+----------+----------+----------+\n";
+        for (int g = 0; g < (int)rows; g++) {
+            const EnergyBreakdown& e = at64[g];
+            double n = (double)config.iterations;
+            cout << "| " << setw(10) << workloads[g]->name() << " | " << setw(6) << setprecision(2) << cpi[g][2]
+                 << " | " << setw(8) << e.l1 / n << " | " << setw(8) << e.l2 / n << " | " << setw(8) << e.dram / n
+                 << " | " << setw(8) << e.leakage / n << " | " << setw(8) << e.total() / n << " | " << setw(8)
+                 << edp[g][2] << " |\n";
+        }
+        cout << "+------------+--------+----------+----------+----------+----------+----------+----------+\n";
+    }
+
+    // Performance regression check against a golden file of lines
+    //   seed S | iterations N              stream for the CPI points
+    //   cpi <workload> <line> <CPI> <tol>  in-order CPI (run()), relative tolerance
+    //   ooo <workload> <line> <CPI> <tol>  out-of-order CPI (runOoO())
+    //   rate <path> <M accesses/s>         minimum speed of an engine path
+    // Rate paths (block, pipelined, ooo, sharded, events, library) replay
+    // hashProbe, the best of 3 runs. Thresholds are multiplied by
+    // rate_scale; 0 skips them. Returns false on any drift or slow path.
+    bool runPerfCheck(const string& path, double rate_scale) {
+        ifstream in(path);
+        if (!in) {
+            cout << "Cannot read " << path << "\n";
+            return false;
+        }
+        unsigned long long seed = 1;
+        HierarchyConfig cfg = config;
+        int failures = 0, checks = 0;
+        string text;
+        cout << "\nPerformance check against " << path << "\n";
+        auto report = [&](const string& what, double value, double golden, bool ok, const char *label = "golden") {
+            checks++;
+            failures += !ok;
+            cout << (ok ? "[PASS] " : "[FAIL] ") << left << setw(28) << what << right << fixed << setprecision(4)
+                 << setw(10) << value << "  (" << label << " " << golden << ")\n";
+        };
+        while (getline(in, text)) {
+            text = text.substr(0, text.find('#'));
+            istringstream line(text);
+            string kind;
+            if (!(line >> kind)) continue;
+            if (kind == "seed") { line >> seed; continue; }
+            if (kind == "iterations") { line >> cfg.iterations; continue; }
+
+            CacheSimulator sim(seed);
+            sim.setConfig(cfg);
+            auto workloads = sim.defaultWorkloads();
+            auto find = [&](const string& name) {
+                for (int g = 0; g < (int)workloads.size(); g++) if (workloads[g]->name() == name) return g;
+                return -1;
+            };
+            if (kind == "cpi" || kind == "ooo") {
+                string name;
+                int l1_line = 0;
+                double golden = 0, tolerance = 0;
+                line >> name >> l1_line >> golden >> tolerance;
+                int g = find(name);
+                if (g < 0 || !line) {
+                    report(text, 0, golden, false);
+                    continue;
+                }
+                double cpi;
+                seed_stream(seed, g, l1_line, 0);
+                if (kind == "cpi") {
+                    cpi = sim.run(*workloads[g], l1_line);
+                } else {
+                    TwoLevelCache cache(l1_line, cfg);
+                    CoreModel core(cfg, cfg.l1_hit_time);
+                    cpi = sim.runOoO(*workloads[g], cache, core);
+                }
+                report(kind + " " + name + " " + to_string(l1_line) + "B", cpi, golden,
+                       fabs(cpi - golden) <= tolerance * golden);
+            } else if (kind == "rate") {
+                string engine;
+                double minimum = 0;
+                line >> engine >> minimum;
+                double rate = measureRate(seed, cfg, engine) / 1e6;
+                bool ok = rate > 0 && (rate_scale == 0 || rate >= minimum * rate_scale);
+                report("rate " + engine + " (M acc/s)", rate, minimum * rate_scale, ok, "min");
+            } else {
+                report(text, 0, 0, false);
+            }
+        }
+        cout << (checks - failures) << "/" << checks << " performance checks passed\n";
+        return failures == 0 && checks > 0;
+    }
+
+    // Accesses per second of one engine path, best of 3
+    double measureRate(unsigned long long seed, HierarchyConfig cfg, const string& engine) {
+        cfg.iterations = 1 << 21;
+        CacheSimulator sim(seed);
+        sim.setConfig(cfg);
+        auto workloads = sim.defaultWorkloads();
+        int g = 0;
+        while (g < (int)workloads.size() && workloads[g]->name() != "hashProbe") g++;
+        if (g == (int)workloads.size()) return 0;
+        WorkloadGenerator& gen = *workloads[g];
+        const size_t n = 1 << 20;
+        vector<unsigned long long> addrs(n);
+        vector<unsigned char> writes(n);
+        LaneRng rng(derive_seed(sim.getMasterSeed(), g, 64, 0));
+        vector<uint32_t> draws(n);
+        rng.fill(draws.data(), (int)n);
+        gen.reset();
+        for (size_t i = 0; i < n; i += BULK_BLOCK) gen.fill(addrs.data() + i, BULK_BLOCK, rng);
+        for (size_t i = 0; i < n; i++) writes[i] = (unsigned char)(draws[i] >> 31);
+
+        double best = 0;
+        for (int rep = 0; rep < 3; rep++) {
+            seed_stream(sim.getMasterSeed(), g, 64, rep);
+            unsigned long long accesses = 0;
+            auto start = chrono::steady_clock::now();
+            if (engine == "block" || engine == "pipelined" || engine == "ooo") {
+                TwoLevelCache cache(64, cfg);
+                if (engine == "block") {
+                    sim.runOn(gen, cache);
+                } else if (engine == "ooo") {
+                    CoreModel core(cfg, cfg.l1_hit_time);
+                    sim.runOoO(gen, cache, core);
+                } else {
+                    // Same stream as block; its cache is internal, so the
+                    // access count is the expected one
+                    PipelineStats stats;
+                    sim.runPipelined(gen, 64, stats);
+                    accesses = (unsigned long long)(cfg.iterations * cfg.mem_ratio);
+                }
+                if (!accesses) accesses = cache.getL1Cache()->getHits() + cache.getL1Cache()->getMisses();
+            } else if (engine == "sharded") {
+                ShardedHierarchy cache(64, cfg, 2, sim.getMasterSeed());
+                cache.access(addrs.data(), writes.data(), n);
+                accesses = n;
+            } else if (engine == "events") {
+                runEventDriven(addrs.data(), writes.data(), n, 64, cfg, 8);
+                accesses = n;
+            } else if (engine == "library") {
+                cachesim::Config lc;
+                auto lib = cachesim::Hierarchy::create(lc);
+                vector<uint64_t> wide(addrs.begin(), addrs.end());
+                start = chrono::steady_clock::now();
+                lib->access(wide, span<const uint8_t>(writes.data(), n));
+                accesses = n;
+            } else {
+                return 0;
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            best = max(best, accesses / seconds);
+        }
+        return best;
+    }
+
+    // The grid on the out-of-order core: CPI per line size next to the
+    // in-order CPI, and the MLP histogram of each workload at 64B lines
+    void runCoreSimulations() {
+        int line_sizes[] = {16, 32, 64, 128};
+        auto workloads = defaultWorkloads();
+        vector<vector<double>> cpi(workloads.size(), vector<double>(4));
+        vector<vector<double>> in_order(workloads.size(), vector<double>(4));
+        vector<vector<unsigned long long>> hist(workloads.size(), vector<unsigned long long>(MLP_BUCKETS));
+        vector<double> mean_mlp(workloads.size());
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            for (int l = 0; l < 4; l++) {
+                seed_stream(master_seed, g, line_sizes[l], 0);
+                in_order[g][l] = run(*workloads[g], line_sizes[l]);
+                seed_stream(master_seed, g, line_sizes[l], 0);
+                TwoLevelCache cache(line_sizes[l], config);
+                CoreModel core(config, config.l1_hit_time);
+                cpi[g][l] = runOoO(*workloads[g], cache, core);
+                if (line_sizes[l] == 64) {
+                    hist[g].assign(core.getMLPHistogram(), core.getMLPHistogram() + MLP_BUCKETS);
+                    mean_mlp[g] = core.getMeanMLP();
+                }
+            }
+        }
+
+        cout << "\nOut-of-order core: ROB " << config.rob_size << ", width " << config.issue_width << ", LSQ "
+             << config.lsq_size << ", load dependency " << setprecision(2) << config.load_dependency
+             << " (master seed " << master_seed << ")\nHierarchy: ";
+        config.print(cout);
+        cout << "\n+------------+----------------+----------------+----------------+----------------+\n";
+        cout << "| Generator  |  16B OoO (InO) |  32B OoO (InO) |  64B OoO (InO) | 128B OoO (InO) |\n";
+        cout << "+------------+----------------+----------------+----------------+----------------+\n";
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            cout << "| " << setw(10) << workloads[g]->name() << " ";
+            for (int l = 0; l < 4; l++) {
+                cout << "| " << setw(6) << fixed << setprecision(3) << cpi[g][l] << " (" << setw(5)
+                     << setprecision(2) << in_order[g][l] << ") ";
+            }
+            cout << "|\n";
+        }
+        cout << "+------------+----------------+----------------+----------------+----------------+\n";
+
+        cout << "\nMLP histogram at 64B lines (% of L1 misses by misses in flight when issued):\n";
+        cout << "+------------+-------+-------+-------+-------+-------+-------+-------+--------+\n";
+        cout << "| Generator  |     1 |     2 |   3-4 |   5-8 |  9-16 | 17-32 |   33+ |   Mean |\n";
+        cout << "+------------+-------+-------+-------+-------+-------+-------+-------+--------+\n";
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            unsigned long long misses = accumulate(hist[g].begin(), hist[g].end(), 0ULL);
+            cout << "| " << setw(10) << workloads[g]->name() << " ";
+            for (int b = 0; b < MLP_BUCKETS; b++) {
+                cout << "| " << setw(5) << setprecision(1) << (misses ? 100.0 * hist[g][b] / misses : 0.0) << " ";
+            }
+            cout << "| " << setw(6) << setprecision(2) << mean_mlp[g] << " |\n";
+        }
+        cout << "+------------+-------+-------+-------+-------+-------+-------+-------+--------+\n";
+    }
+
+    // Run replicates of several (generator, line size) points on a pool of
+    // workers. Each job is one replicate; a worker takes the next replicate
+    // of the point with the fewest issued so far. Early stopping is decided
+    // on the completed prefix of replicates in index order, and replicates
+    // finishing beyond the stopping point are discarded, so the statistics
+    // do not depend on the thread count or on completion order.
+    vector<ReplicateStats> runReplicates(const vector<pair<int, int>>& points, const ReplicateConfig& rc, int threads) {
+        struct PointState {
+            vector<double> cpi;
+            vector<char> done;
+            int issued = 0, completed_prefix = 0, stop_at = -1;
+        };
+        int max_reps = max(1, rc.max_replicates);
+        int min_reps = min(max(2, rc.min_replicates), max_reps);
+        vector<PointState> state(points.size());
+        for (auto& st : state) {
+            st.cpi.assign(max_reps, 0.0);
+            st.done.assign(max_reps, 0);
+        }
+        mutex lock;
+
+        auto worker = [&]() {
+            auto workloads = defaultWorkloads();
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                int best = -1;
+                for (int p = 0; p < (int)points.size(); p++) {
+                    if (state[p].stop_at < 0 && state[p].issued < max_reps &&
+                        (best < 0 || state[p].issued < state[best].issued)) {
+                        best = p;
+                    }
+                }
+                if (best < 0) return;
+                int r = state[best].issued++;
+                guard.unlock();
+
+                int g = points[best].first, line = points[best].second;
+                seed_stream(master_seed, g, line, r);
+                double cpi = run(*workloads[g], line);
+
+                guard.lock();
+                PointState& st = state[best];
+                st.cpi[r] = cpi;
+                st.done[r] = 1;
+                while (st.stop_at < 0 && st.completed_prefix < max_reps && st.done[st.completed_prefix]) {
+                    int n = ++st.completed_prefix;
+                    if (n == max_reps ||
+                        (rc.target_half_width > 0 && n >= min_reps &&
+                         ReplicateStats::of(st.cpi.data(), n).ci_half_width <= rc.target_half_width)) {
+                        st.stop_at = n;
+                    }
+                }
+            }
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+
+        vector<ReplicateStats> stats;
+        for (auto& st : state) stats.push_back(ReplicateStats::of(st.cpi.data(), st.stop_at));
+        return stats;
+    }
+
+    // runSimulations() grid with replicates: mean, standard deviation and
+    // 95% confidence interval of the CPI at each point
+    void runReplicatedSimulations(const ReplicateConfig& rc, int threads) {
+        auto workloads = defaultWorkloads();
+        int line_sizes[] = {16, 32, 64, 128};
+        vector<pair<int, int>> points;
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            for (int l = 0; l < 4; l++) points.push_back({g, line_sizes[l]});
+        }
+        auto start = chrono::steady_clock::now();
+        vector<ReplicateStats> stats = runReplicates(points, rc, threads);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "\n" << string(70, '=') << "\n";
+        cout << "               CACHE SIMULATION RESULTS (REPLICATED)\n";
+        cout << string(70, '=') << "\n";
+        cout << "Master seed: " << master_seed << ", up to " << max(1, rc.max_replicates) << " replicates";
+        if (rc.target_half_width > 0) cout << ", stopping at 95% CI half-width <= " << fixed << setprecision(4) << rc.target_half_width;
+        cout << "\n";
+
+        cout << "\n+------------+------+------------+------------+------------+------+\n";
+        cout << "| Generator  | Line |   Mean CPI |     Stddev |  95% CI +- |    n |\n";
+        cout << "+------------+------+------------+------------+------------+------+\n";
+        int runs = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            const ReplicateStats& st = stats[i];
+            cout << "| " << setw(10) << workloads[points[i].first]->name() << " | " << setw(4) << points[i].second
+                 << " | " << setw(10) << fixed << setprecision(4) << st.mean << " | " << setw(10) << st.stddev
+                 << " | " << setw(10) << st.ci_half_width << " | " << setw(4) << st.replicates << " |\n";
+            runs += st.replicates;
+        }
+        cout << "+------------+------+------------+------------+------------+------+\n";
+        cout << runs << " runs on " << threads << " threads in " << setprecision(2) << seconds << " s\n";
+    }
+
+    // Successive halving over prefixes of one workload's instruction stream.
+    // Rung r runs every surviving point for iterations / DSE_ETA^(rungs-1-r)
+    // instructions; after each rung the points are ranked by Pareto layer
+    // (then CPI) and only the best 1/DSE_ETA go on, but the current
+    // frontier always survives. Every point draws the same random stream
+    // (common random numbers), so points are compared on identical input
+    // and the result does not depend on the thread count.
+    DseResult exploreDesignSpace(const DesignSpace& space, int workload, int threads, int rungs = DSE_RUNGS) {
+        DseResult result;
+        vector<DesignPoint> points = space.expand(config, 64, result.invalid);
+        for (int r = 0; r < rungs && !points.empty(); r++) {
+            unsigned long long instructions = max(1.0, config.iterations / pow(DSE_ETA, rungs - 1 - r));
+            evaluateDesigns(points, workload, instructions, threads);
+            result.rungs.push_back({points.size(), instructions});
+            result.simulated_instructions += points.size() * instructions;
+
+            vector<int> rank = paretoRanks(points);
+            vector<size_t> order(points.size());
+            iota(order.begin(), order.end(), 0);
+            sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return rank[a] != rank[b] ? rank[a] < rank[b] : points[a].cpi < points[b].cpi;
+            });
+            size_t keep = (size_t)count(rank.begin(), rank.end(), 0);
+            if (r < rungs - 1) keep = max(keep, (points.size() + DSE_ETA - 1) / DSE_ETA);
+            vector<DesignPoint> survivors;
+            for (size_t i = 0; i < keep; i++) survivors.push_back(points[order[i]]);
+            points.swap(survivors);
+        }
+        sort(points.begin(), points.end(), [](const DesignPoint& a, const DesignPoint& b) {
+            return a.area_kb < b.area_kb;
+        });
+        result.frontier = points;
+        return result;
+    }
+
+    // Evaluate points on a pool of worker threads pulling from a shared index
+    void evaluateDesigns(vector<DesignPoint>& points, int workload, unsigned long long instructions, int threads) {
+        atomic<size_t> next(0);
+        auto worker = [&]() {
+            auto workloads = defaultWorkloads();
+            for (size_t i; (i = next.fetch_add(1)) < points.size();) {
+                DesignPoint& p = points[i];
+                seed_stream(master_seed, workload, 0, 0);
+                TwoLevelCache cache(p.l1_line_size, p.config);
+                LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+                workloads[workload]->reset();
+                p.cpi = (double)runBlocks(*workloads[workload], cache, rng, instructions, true) / instructions;
+            }
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+    }
+
+    void runDesignSpaceExploration(const DesignSpace& space, int workload, int threads) {
+        auto workloads = defaultWorkloads();
+        auto start = chrono::steady_clock::now();
+        DseResult result = exploreDesignSpace(space, workload, threads);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "\nDesign-space exploration on " << workloads[workload]->name() << " (master seed "
+             << master_seed << ", " << threads << " threads)\n";
+        for (size_t r = 0; r < result.rungs.size(); r++) {
+            cout << "  Rung " << r + 1 << ": " << result.rungs[r].first << " points x "
+                 << result.rungs[r].second << " instructions\n";
+        }
+        if (result.invalid) cout << "  " << result.invalid << " invalid geometries skipped\n";
+        unsigned long long exhaustive = result.rungs.empty() ? 0 : result.rungs[0].first * config.iterations;
+        cout << "  Simulated " << result.simulated_instructions << " instructions ("
+             << fixed << setprecision(1) << 100.0 * result.simulated_instructions / max(1ULL, exhaustive)
+             << "% of exhaustive) in " << setprecision(2) << seconds << " s\n";
+
+        cout << "\nPareto frontier, CPI against area:\n";
+        cout << "+------------+---------------------+---------------------+------------+\n";
+        cout << "|  Area (KB) | L1 size/ways/line   | L2 size/ways/line   |        CPI |\n";
+        cout << "+------------+---------------------+---------------------+------------+\n";
+        for (const DesignPoint& p : result.frontier) {
+            string l1 = to_string(p.config.l1_size >> 10) + "KB/" + to_string(p.config.l1_assoc) + "/" +
+                        to_string(p.l1_line_size) + "B";
+            string l2 = to_string(p.config.l2_size >> 10) + "KB/" + to_string(p.config.l2_assoc) + "/" +
+                        to_string(p.config.l2_line_size) + "B";
+            cout << "| " << setw(10) << setprecision(1) << p.area_kb << " | " << left << setw(19) << l1
+                 << " | " << setw(19) << l2 << right << " | " << setw(10) << setprecision(4) << p.cpi << " |\n";
+        }
+        cout << "+------------+---------------------+---------------------+------------+\n";
+    }
+
+    // Record `accesses` memory accesses of a workload (types drawn as in
+    // runBlocks) into a trace file
+    bool writeWorkloadTrace(WorkloadGenerator& gen, const string& path, unsigned long long accesses) {
+        TraceWriter writer;
+        if (!writer.open(path)) return false;
+        LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+        uint32_t draws[BULK_BLOCK];
+        unsigned long long addrs[BULK_BLOCK];
+        gen.reset();
+        while (accesses > 0) {
+            int n = accesses < BULK_BLOCK ? (int)accesses : BULK_BLOCK;
+            rng.fill(draws, n);
+            gen.fill(addrs, n, rng);
+            for (int i = 0; i < n; i++) writer.append(addrs[i], (draws[i] >> 31) ? WRITE_ACCESS : read_ACCESS);
+            accesses -= n;
+        }
+        return writer.close();
+    }
+
+    // Replay a trace through a hierarchy; returns the total access cycles
+    // The first config.warmup records only warm the hierarchy
+    unsigned long long replayTrace(TraceReader& reader, TwoLevelCache& cache) {
+        unsigned long long addrs[BULK_BLOCK];
+        unsigned char writes[BULK_BLOCK];
+        unsigned long long total_cycles = 0, warming = config.warmup;
+        int n;
+        while ((n = reader.next(addrs, writes, BULK_BLOCK)) > 0) {
+            int i = 0;
+            for (; i < n && warming > 0; i++, warming--) cache.warmAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+            for (; i < n; i++) {
+                total_cycles += cache.memoryAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+            }
+        }
+        return total_cycles;
+    }
+
+    // Average memory access time of a trace for each L1 line size. Other
+    // formats are parsed once into a temporary native trace, so every line
+    // size (and --pipelined, --shards and --events) replays decoded records.
+    // The first config.warmup records of each replay only warm the caches.
+    bool runTrace(const string& path, TraceFormat format = NATIVE_TRACE) {
+        if (format == NATIVE_TRACE) return replayNativeTrace(path, path, nullptr);
+        string native = (filesystem::temp_directory_path() / ("cachesim-import-" + to_string(getpid()) + ".trc")).string();
+        ImportStats stats;
+        bool ok = convertTrace(format, path, native, stats);
+        if (!ok) cout << "Cannot read trace " << path << "\n";
+        ok = ok && replayNativeTrace(native, path, &stats);
+        remove(native.c_str());
+        return ok;
+    }
+
+    // runTrace's table for a native trace; label and imported (the
+    // instruction count of an imported trace) are only printed
+    bool replayNativeTrace(const string& path, const string& label, const ImportStats *imported) {
+        int line_sizes[] = {16, 32, 64, 128};
+        PipelineStats pipeline_stats;
+        TraceReader probe;
+        if (!probe.open(path)) {
+            cout << "Cannot read trace " << label << "\n";
+            return false;
+        }
+        if (pipelined && (shards > 1 || event_window > 0)) {
+            cout << "--pipelined cannot be combined with --shards or --events\n";
+            return false;
+        }
+        unsigned long long accesses = probe.getTotalRecords();
+        cout << "\nTrace " << label << ": " << accesses << " accesses";
+        if (imported) cout << ", " << imported->instructions << " instructions";
+        cout << " (average access time, cycles)\n";
+        cout << "+------------+------------+------------+------------+\n";
+        cout << "|   16B Line |   32B Line |   64B Line |  128B Line |\n";
+        cout << "+------------+------------+------------+------------+\n";
+        if (event_window > 0) return runTraceEvents(path, accesses);
+        for (int l = 0; l < 4; l++) {
+            seed_stream(master_seed, 0, line_sizes[l], 0);
+            if (shards > 1) {
+                ShardedHierarchy cache(line_sizes[l], config, shards, derive_seed(master_seed, 0, line_sizes[l], 0));
+                replayTraceSharded(path, cache);
+                cout << "| " << setw(10) << fixed << setprecision(4) << cache.getAverageAccessTime() << " ";
+                continue;
+            }
+            TwoLevelCache cache(line_sizes[l], config);
+            TraceReader reader;
+            reader.open(path);
+            if (pipelined) replayTracePipelined(reader, cache, pipeline_stats);
+            else replayTrace(reader, cache);
+            if (reader.isCorrupt()) {
+                cout << "|\nTrace " << label << " has a record that does not decode within its block\n";
+                return false;
+            }
+            cout << "| " << setw(10) << fixed << setprecision(4) << cache.getAverageAccessTime() << " ";
+        }
+        cout << "|\n+------------+------------+------------+------------+\n";
+        if (pipelined) printPipelineStats(pipeline_stats);
+        return true;
+    }
+
+    // Event-driven replay of a trace loaded into memory, with up to
+    // event_window accesses outstanding; prints the average access time
+    // row of runTrace's table and the overlap and engine throughput
+    bool runTraceEvents(const string& path, unsigned long long accesses) {
+        int line_sizes[] = {16, 32, 64, 128};
+        vector<unsigned long long> addrs;
+        vector<unsigned char> writes;
+        addrs.reserve(accesses);
+        writes.reserve(accesses);
+        TraceReader reader;
+        reader.open(path);
+        unsigned long long block[BULK_BLOCK];
+        unsigned char block_writes[BULK_BLOCK];
+        int n;
+        while ((n = reader.next(block, block_writes, BULK_BLOCK)) > 0) {
+            addrs.insert(addrs.end(), block, block + n);
+            writes.insert(writes.end(), block_writes, block_writes + n);
+        }
+        EventRunStats runs[4];
+        for (int l = 0; l < 4; l++) {
+            seed_stream(master_seed, 0, line_sizes[l], 0);
+            runs[l] = runEventDriven(addrs.data(), writes.data(), addrs.size(), line_sizes[l], config, event_window, 0,
+                                     config.warmup);
+            cout << "| " << setw(10) << fixed << setprecision(4) << runs[l].averageLatency() << " ";
+        }
+        cout << "|\n+------------+------------+------------+------------+\n";
+        unsigned long long events = 0;
+        double seconds = 0;
+        cout << "Event-driven, window " << event_window << ": cycles per access";
+        for (int l = 0; l < 4; l++) {
+            cout << (l ? " / " : " ") << setprecision(4)
+                 << (runs[l].accesses ? (double)runs[l].finish_time / runs[l].accesses : 0.0);
+            events += runs[l].events;
+            seconds += runs[l].seconds;
+        }
+        cout << "\nEvent engine: " << events << " events, " << setprecision(1)
+             << (seconds > 0 ? events / seconds / 1e6 : 0.0) << " M events/s\n";
+        return true;
+    }
+
+    // Replay a native trace in SHARD_CHUNK chunks through a set-sharded
+    // hierarchy; the first config.warmup records only warm it
+    void replayTraceSharded(const string& path, ShardedHierarchy& cache) {
+        vector<unsigned long long> addrs(SHARD_CHUNK);
+        vector<unsigned char> writes(SHARD_CHUNK);
+        size_t n = 0;
+        unsigned long long warming = config.warmup;
+        auto flush = [&]() {
+            size_t w = (size_t)min<unsigned long long>(warming, n);
+            if (w) cache.warm(addrs.data(), writes.data(), w);
+            if (n > w) cache.access(addrs.data() + w, writes.data() + w, n - w);
+            warming -= w;
+            n = 0;
+        };
+        TraceReader reader;
+        reader.open(path);
+        int got;
+        while ((got = reader.next(addrs.data() + n, writes.data() + n, (int)min<size_t>(SHARD_CHUNK - n, BULK_BLOCK))) > 0) {
+            n += got;
+            if (n == SHARD_CHUNK) flush();
+        }
+        if (n) flush();
+    }
+
+    unsigned long long warmupCount(unsigned long long warmup_instructions) const {
+        return warmup_instructions == CONFIG_WARMUP ? config.warmup : warmup_instructions;
+    }
+
+    // Pipelined equivalent of run(): the workload is generated on a producer
+    // thread into a lock-free ring and simulated here. The producer resets
+    // its own generator state and draws from the same LaneRng sequence as
+    // runBlocks (warmup batches first), so the CPI matches run() exactly.
+    double runPipelined(WorkloadGenerator& gen, int l1_line_size, PipelineStats& stats) {
+        TwoLevelCache cache(l1_line_size, config);
+        LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+        unsigned long long warming = config.warmup, remaining = config.iterations;
+        const uint32_t threshold = config.memThreshold();
+        bool started = false;
+        auto produce = [&](AccessBatch& batch) {
+            if (!started) { gen.reset(); started = true; }
+            if (warming == 0 && remaining == 0) return false;
+            batch.warm = warming > 0;
+            unsigned long long& left = batch.warm ? warming : remaining;
+            uint32_t draws[BULK_BLOCK];
+            int n = left < BULK_BLOCK ? (int)left : BULK_BLOCK;
+            rng.fill(draws, n);
+            int mem = 0;
+            for (int i = 0; i < n; i++) mem += (draws[i] <= threshold);
+            rng.fill(draws, mem);
+            gen.fill(batch.addrs, mem, rng);
+            for (int i = 0; i < mem; i++) batch.writes[i] = (unsigned char)(draws[i] >> 31);
+            batch.instructions = n;
+            batch.count = mem;
+            left -= n;
+            return true;
+        };
+        return (double)runPipeline(produce, cache, stats) / config.iterations;
+    }
+
+    // Trace replay with decoding on the producer thread; warmup records go
+    // in whole batches of their own
+    unsigned long long replayTracePipelined(TraceReader& reader, TwoLevelCache& cache, PipelineStats& stats) {
+        unsigned long long warming = config.warmup;
+        auto produce = [&](AccessBatch& batch) {
+            batch.warm = warming > 0;
+            int want = batch.warm ? (int)min<unsigned long long>(warming, BULK_BLOCK) : BULK_BLOCK;
+            batch.count = batch.instructions = reader.next(batch.addrs, batch.writes, want);
+            if (batch.warm) warming -= batch.count;
+            return batch.count > 0;
+        };
+        return runPipeline(produce, cache, stats);
+    }
+
+    double run(ScalarGenerator gen, int l1_line_size, unsigned long long warmup_instructions = CONFIG_WARMUP) {
+        TwoLevelCache cache(l1_line_size, config);
+        fastForward(gen, cache, warmupCount(warmup_instructions));
+        return (double)runDetailed(gen, cache, config.iterations) / config.iterations;
+    }
+
+    // Block-driven run: the instruction mix, access types and addresses for
+    // up to BULK_BLOCK instructions are generated in bulk from a LaneRng
+    // seeded off this thread's stream, then only the memory accesses are
+    // replayed. Non-memory instructions cost 1 cycle each and the
+    // hierarchy is synchronous, so they are accounted per block.
+    double run(WorkloadGenerator& gen, int l1_line_size, unsigned long long warmup_instructions = CONFIG_WARMUP) {
+        TwoLevelCache cache(l1_line_size, config);
+        return runOn(gen, cache, warmup_instructions);
+    }
+
+    // Same as run(), on a caller-owned hierarchy whose statistics can be
+    // inspected afterwards
+    double runOn(WorkloadGenerator& gen, TwoLevelCache& cache, unsigned long long warmup_instructions = CONFIG_WARMUP) {
+        LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+        gen.reset();
+        runBlocks(gen, cache, rng, warmupCount(warmup_instructions), false);
+        return (double)runBlocks(gen, cache, rng, config.iterations, true) / config.iterations;
+    }
+
+    double run(BulkGenerator gen, int l1_line_size, unsigned long long warmup_instructions = CONFIG_WARMUP) {
+        BulkWorkload workload("", gen);
+        return run(workload, l1_line_size, warmup_instructions);
+    }
+
+    unsigned long long runBlocks(WorkloadGenerator& gen, TwoLevelCache& cache, LaneRng& rng,
+                                 unsigned long long instructions, bool detailed) {
+        uint32_t draws[BULK_BLOCK];
+        unsigned long long addrs[BULK_BLOCK];
+        unsigned long long total_cycles = 0;
+        const uint32_t threshold = config.memThreshold();
+        while (instructions > 0) {
+            int n = instructions < BULK_BLOCK ? (int)instructions : BULK_BLOCK;
+            rng.fill(draws, n);
+            int mem = 0;
+            for (int i = 0; i < n; i++) mem += (draws[i] <= threshold);
+            rng.fill(draws, mem);
+            gen.fill(addrs, mem, rng);
+
+            if (detailed) {
+                total_cycles += n - mem;
+                cache.advance(n - mem);
+                for (int i = 0; i < mem; i++) {
+                    total_cycles += cache.memoryAccess(addrs[i], (draws[i] >> 31) ? WRITE_ACCESS : read_ACCESS);
+                }
+            } else {
+                for (int i = 0; i < mem; i++) cache.warmAccess(addrs[i], (accessType)(draws[i] >> 31));
+            }
+            instructions -= n;
+        }
+        return total_cycles;
+    }
+
+    // runBlocks through an out-of-order core: the same draws, addresses and
+    // cache accesses, with the per-access cycles fed to the core model in
+    // program order instead of being summed
+    void runBlocksOoO(WorkloadGenerator& gen, TwoLevelCache& cache, LaneRng& rng,
+                      unsigned long long instructions, CoreModel& core) {
+        uint32_t draws[BULK_BLOCK];
+        unsigned long long addrs[BULK_BLOCK];
+        unsigned char is_mem[BULK_BLOCK];
+        const uint32_t threshold = config.memThreshold();
+        while (instructions > 0) {
+            int n = instructions < BULK_BLOCK ? (int)instructions : BULK_BLOCK;
+            rng.fill(draws, n);
+            int mem = 0;
+            for (int i = 0; i < n; i++) mem += (is_mem[i] = draws[i] <= threshold);
+            rng.fill(draws, mem);
+            gen.fill(addrs, mem, rng);
+            cache.advance(n - mem);
+            for (int i = 0, m = 0; i < n; i++) {
+                if (!is_mem[i]) {
+                    core.nonMemory();
+                    continue;
+                }
+                bool write = draws[m] >> 31;
+                core.memory(write, cache.memoryAccess(addrs[m], write ? WRITE_ACCESS : read_ACCESS), draws[m]);
+                m++;
+            }
+            instructions -= n;
+        }
+    }
+
+    // CPI of a workload on the out-of-order core, after the same stream
+    // position and cache state as runOn()
+    double runOoO(WorkloadGenerator& gen, TwoLevelCache& cache, CoreModel& core) {
+        LaneRng rng(((unsigned long long)m_z << 32) | m_w);
+        gen.reset();
+        runBlocks(gen, cache, rng, config.warmup, false);
+        runBlocksOoO(gen, cache, rng, config.iterations, core);
+        return core.getCPI();
+    }
+
+    // Functional warmup over an instruction stream: the same draws, in the
+    // same order, as runDetailed() (memory/non-memory, then read/write, then
+    // the address), so the stream is where a detailed run would have left
+    // it. The draws are compared as integers and only the warm path runs.
+    void fastForward(ScalarGenerator gen, TwoLevelCache& cache, unsigned long long instructions) {
+        const uint32_t threshold = config.memThreshold();
+        for (unsigned long long i = 0; i < instructions; i++) {
+            if (rand_() > threshold) continue;
+            accessType type = rand_() < 0x80000000u ? read_ACCESS : WRITE_ACCESS;
+            cache.warmAccess(gen(), type);
+        }
+    }
+
+    // Advance a generator past the accesses of instructions skipped
+    // instructions (their expected count at mem_ratio) without touching any
+    // cache; the instruction mix itself is not drawn.
+    void skipForward(WorkloadGenerator& gen, LaneRng& rng, unsigned long long instructions) {
+        unsigned long long scratch[BULK_BLOCK];
+        unsigned long long accesses = llround(instructions * config.mem_ratio);
+        while (accesses > 0) {
+            int n = accesses < BULK_BLOCK ? (int)accesses : BULK_BLOCK;
+            gen.fill(scratch, n, rng);
+            accesses -= n;
+        }
+    }
+
+    // Estimate CPI from systematic samples on the block path. Every period
+    // draws from its own LaneRng, seeded from the start state and the
+    // period index, so reaching a period needs no draws for the instructions
+    // before it. If the confidence bound misses the target, the stream is
+    // replayed from the same starting state with the sample count the
+    // measured variation calls for. Returns 0 samples if the stream is too
+    // short for two units.
+    SampledResult runSampled(WorkloadGenerator& gen, int l1_line_size, const SamplingConfig& cfg = SamplingConfig()) {
+        const unsigned long long base_seed = ((unsigned long long)m_z << 32) | m_w;
+        unsigned long long unit_span = cfg.unit_size + cfg.detailed_warmup;
+        SampledResult result;
+        if (cfg.unit_size == 0 || cfg.total_instructions / 2 < unit_span) return result;
+        int max_samples = (int)min<unsigned long long>(cfg.total_instructions / unit_span, 1ULL << 30);
+        int samples = max(2, min(cfg.initial_samples, max_samples));
+
+        vector<double> unit_cpi;
+        for (int round = 1; round <= cfg.max_rounds; round++) {
+            gen.reset();
+            TwoLevelCache cache(l1_line_size, config);
+            unsigned long long period = cfg.total_instructions / samples;
+            unsigned long long gap = period - unit_span;
+            unsigned long long warming = min(gap, cfg.functional_warming);
+            unit_cpi.assign(samples, 0.0);
+            for (int k = 0; k < samples; k++) {
+                LaneRng rng(mix64(base_seed + k));
+                skipForward(gen, rng, gap - warming);
+                runBlocks(gen, cache, rng, warming, false);
+                runBlocks(gen, cache, rng, cfg.detailed_warmup, true);
+                unit_cpi[k] = (double)runBlocks(gen, cache, rng, cfg.unit_size, true) / cfg.unit_size;
+            }
+
+            double mean = 0.0, var = 0.0;
+            for (double c : unit_cpi) mean += c;
+            mean /= samples;
+            for (double c : unit_cpi) var += (c - mean) * (c - mean);
+            double stddev = sqrt(var / (samples - 1));
+
+            result.cpi = mean;
+            result.ci_half_width = cfg.confidence_z * stddev / sqrt((double)samples);
+            result.relative_error = mean > 0 ? result.ci_half_width / mean : 0.0;
+            result.samples = samples;
+            result.rounds = round;
+            if (result.relative_error <= cfg.target_error || samples >= max_samples) break;
+
+            // n = (z * V / e)^2, with V the coefficient of variation
+            double needed = pow(cfg.confidence_z * (stddev / mean) / cfg.target_error, 2);
+            samples = (int)min<double>(max_samples, max<double>(ceil(needed * 1.1), samples + 1.0));
+        }
+        return result;
+    }
+
+    SampledResult runSampled(BulkGenerator gen, int l1_line_size, const SamplingConfig& cfg = SamplingConfig()) {
+        BulkWorkload workload("", gen);
+        return runSampled(workload, l1_line_size, cfg);
+    }
+
+    unsigned long long runDetailed(ScalarGenerator gen, TwoLevelCache& cache, unsigned long long instructions) {
         unsigned long long total_cycles = 0;
         unsigned long long memory_accesses = 0;
         unsigned long long non_memory_instructions = 0;
 
-        for (int i = 0; i < NO_OF_ITERATIONS; i++) {
+        for (unsigned long long i = 0; i < instructions; i++) {
             double p = (double)rand_() / 0xFFFFFFFF;
-            if (p <= 0.35) {
+            if (p <= config.mem_ratio) {
                 // Memory access instruction
                 memory_accesses++;
                 accessType type = ((double)rand_() / 0xFFFFFFFF < 0.5) ? read_ACCESS : WRITE_ACCESS;
@@ -257,13 +1476,24 @@ public:
              << ", Total cycles: " << total_cycles << endl;
         */
 
-        return (double)total_cycles / NO_OF_ITERATIONS;
+        return total_cycles;
     }
 
-    void runComprehensiveTests() {
+    bool runComprehensiveTests() {
         cout << "\n" << string(70, '=') << "\n";
         cout << "                    COMPREHENSIVE TEST SUITE\n";
         cout << string(70, '=') << "\n";
+        seed_random(master_seed);
+
+        // The expectations hold for the default hierarchy and engine, so
+        // --config, --set and the run-mode flags are set aside meanwhile
+        HierarchyConfig saved_config = config;
+        bool saved_pipelined = pipelined;
+        int saved_shards = shards, saved_event_window = event_window;
+        config = HierarchyConfig();
+        pipelined = false;
+        shards = 1;
+        event_window = 0;
 
         int passed = 0, total = 0;
 
@@ -287,6 +1517,14 @@ public:
         cout << string(50, '-') << "\n";
         runHitMissRatioTests(passed, total);
 
+        cout << "\n>>> TRACE FORMAT TESTS <<<\n";
+        cout << string(50, '-') << "\n";
+        runTraceTests(passed, total);
+
+        cout << "\n>>> SIMULATION MODE TESTS <<<\n";
+        cout << string(50, '-') << "\n";
+        runSimulationModeTests(passed, total);
+
         cout << "\n" << string(70, '=') << "\n";
         cout << "                       TEST SUMMARY\n";
         cout << string(70, '=') << "\n";
@@ -299,6 +1537,11 @@ public:
             cout << "⚠ Some tests failed. Please review the implementation.\n";
         }
         cout << string(70, '=') << "\n";
+        config = saved_config;
+        pipelined = saved_pipelined;
+        shards = saved_shards;
+        event_window = saved_event_window;
+        return passed == total;
     }
 
 private:
@@ -308,6 +1551,7 @@ private:
         assertTest("Write-back Policy", testWriteBack(), passed, total);
         assertTest("Set Index Mapping", testSetMapping(), passed, total);
         assertTest("Cache Line Alignment", testCacheLineAlignment(), passed, total);
+        assertTest("Packed Line Metadata", testPackedLines(), passed, total);
     }
 
     void runHierarchyTests(int &passed, int &total) {
@@ -315,12 +1559,18 @@ private:
         assertTest("L1 Miss -> L2 Hit", testL1MissL2Hit(), passed, total);
         assertTest("L1 Miss -> L2 Miss", testL1MissL2Miss(), passed, total);
         assertTest("Cache Hierarchy Timing", testHierarchyTiming(), passed, total);
+        assertTest("Checkpoint Save/Restore", testCheckpointRestore(), passed, total);
+        assertTest("Runtime Config and Kernels", testRuntimeConfig(), passed, total);
     }
 
     void runMemoryGeneratorTests(int &passed, int &total) {
         assertTest("Memory Generator Patterns", testMemGenPatterns(), passed, total);
         assertTest("Generator Address Ranges", testGeneratorRanges(), passed, total);
         assertTest("Sequential vs Random Access", testAccessPatterns(), passed, total);
+        assertTest("Bulk Generator Patterns", testBulkGenerators(), passed, total);
+        assertTest("Workload Generator Library", testWorkloadGenerators(), passed, total);
+        assertTest("Skewed Generator Distributions", testSkewedGenerators(), passed, total);
+        assertTest("64-bit Address Coverage", testWideAddresses(), passed, total);
     }
 
     void runPerformanceTests(int &passed, int &total) {
@@ -331,14 +1581,37 @@ private:
 
     void runHitMissRatioTests(int &passed, int &total) {
         assertTest("Sequential Access Hit Rates", testSequentialHitRates(), passed, total);
-        seed_random();
+        seed_random(master_seed);
         assertTest("Random Access Hit Rates", testRandomHitRates(), passed, total);
-        seed_random();
+        seed_random(master_seed);
         assertTest("Working Set Impact", testWorkingSetImpact(), passed, total);
-        seed_random();
+        seed_random(master_seed);
         assertTest("Line Size Impact on Hit Rates", testLineSizeHitRateCorrelation(), passed, total);
     }
 
+    void runTraceTests(int &passed, int &total) {
+        assertTest("Trace Round Trip and Seek", testTraceRoundTrip(), passed, total);
+        assertTest("Dinero/Lackey/ChampSim Import", testTraceImporters(), passed, total);
+    }
+
+    void runSimulationModeTests(int &passed, int &total) {
+        assertTest("Functional Warmup State", testFunctionalWarmup(), passed, total);
+        assertTest("Sampled CPI Estimate", testSampledRun(), passed, total);
+        assertTest("Reproducible Seeded Runs", testSeededRuns(), passed, total);
+        assertTest("Pipelined Producer/Consumer Run", testPipelinedRun(), passed, total);
+        assertTest("Design-Space Exploration", testDesignSpaceExploration(), passed, total);
+        assertTest("Replicates and Confidence Intervals", testReplicates(), passed, total);
+        assertTest("Set-Sharded Hierarchy", testShardedHierarchy(), passed, total);
+        assertTest("Forked Workers with Crash Retry", testForkedGrid(), passed, total);
+        assertTest("Event-Driven Timing Wheel", testEventEngine(), passed, total);
+        assertTest("Out-of-Order Core and MLP", testCoreModel(), passed, total);
+        assertTest("Instruction Fetch and Shared L2", testInstructionFetch(), passed, total);
+        assertTest("Library C++ and C API", testLibraryApi(), passed, total);
+        assertTest("Sectored Lines and Traffic", testSectoredCache(), passed, total);
+        assertTest("Bandwidth-Limited Links", testBandwidthQueueing(), passed, total);
+        assertTest("Energy Model", testEnergyModel(), passed, total);
+    }
+
     void assertTest(const string& name, bool result, int &passed, int &total) {
         string status = result ? "PASS" : "FAIL";
         cout << "[" << status << "] " << name;
@@ -390,10 +1663,30 @@ private:
         auto result = c.access(0x1000, read_ACCESS);
 
         bool hit = (result.first == HIT);
-        if (!hit) {
-            cout << "    ⚠ Write followed by read should hit\n";
+
+        // A dirty L1 victim is installed in L2 without a fill and without
+        // counting as an L2 miss; once L2 evicts it, it goes on to DRAM
+        // (direct-mapped 1KB L1 with 32B lines, 4KB L2 with 64B lines)
+        HierarchyConfig direct;
+        direct.l1_size = 1024;
+        direct.l2_size = 4096;
+        direct.l1_assoc = direct.l2_assoc = 1;
+        TwoLevelCache tlc(32, direct);
+        const Cache& l2 = *tlc.getL2Cache();
+        tlc.memoryAccess(0x0000, WRITE_ACCESS);
+        tlc.memoryAccess(0x1020, read_ACCESS);       // evicts 0x0000 from L2 only
+        tlc.memoryAccess(0x0400, read_ACCESS);       // evicts dirty 0x0000 from L1 into L2
+        bool victim = tlc.getL1Cache()->getDirtyVictim() == 0x0000 && l2.getVictimWrites() == 1 &&
+                      l2.getMisses() == 3 && l2.getFillBytes() == 3 * 64 && l2.getWritebacks() == 0;
+        int cycles = tlc.memoryAccess(0x1000, read_ACCESS);    // evicts it from L2
+        bool propagated = victim && l2.getWritebacks() == 1 && l2.getWritebackBytes() == 64 &&
+                          cycles == direct.l1_hit_time + direct.l2_hit_time + 2 * direct.dram_penalty;
+
+        if (!hit || !propagated) {
+            cout << "    ⚠ Write then read hit: " << hit << ", L1 victim installed: " << victim << ", L2 misses "
+                 << l2.getMisses() << ", writebacks " << l2.getWritebacks() << ", eviction cycles " << cycles << "\n";
         }
-        return hit;
+        return hit && propagated;
     }
 
     bool testSetMapping() {
@@ -411,6 +1704,35 @@ private:
         return test1 && test2;
     }
 
+    bool testPackedLines() {
+        // 8 bytes per line against 24 for {bool, u64, bool}
+        bool size_ok = sizeof(CacheLine) == 8;
+
+        // Valid, dirty and the full tag survive packing, up to the top of
+        // the 64-bit address space
+        Cache cache(1024, 16, 1, 1);
+        unsigned long long high = 0xFFFFFFFFFFFFFFF0ULL;
+        cache.access(0x40, WRITE_ACCESS);
+        cache.access(high, read_ACCESS);
+        const CacheLine *lines = cache.lineData();
+        bool packed_ok = lines[4].valid() && lines[4].dirty() && lines[4].tag() == 0 &&
+                         lines[63].valid() && !lines[63].dirty() && lines[63].tag() == (high >> 10) &&
+                         !lines[0].valid() && cache.access(high, WRITE_ACCESS).first == HIT &&
+                         lines[63].dirty() && cache.getTagBits() == 54;
+
+        // Memory report: line arrays plus the fixed objects
+        TwoLevelCache tlc(64);
+        size_t expected = (256 + 2048) * sizeof(CacheLine);
+        bool report_ok = tlc.memoryBytes() >= expected && tlc.memoryBytes() < expected + 1024;
+
+        bool result = size_ok && packed_ok && report_ok;
+        if (!result) {
+            cout << "    ⚠ Size: " << sizeof(CacheLine) << ", Packed: " << packed_ok
+                 << ", Memory: " << tlc.memoryBytes() << " bytes\n";
+        }
+        return result;
+    }
+
     bool testCacheLineAlignment() {
         Cache c(1024, 64, 2, 1);
 
@@ -453,8 +1775,11 @@ private:
 
         // Fill L1 to force eviction of address 0x1000
         for (int i = 0; i < accesses_needed; i++) {
-            // Access different addresses that map to different sets
-            tlc.memoryAccess(0x100000 + i * 128, read_ACCESS);
+            // Access different addresses that map to different sets, leaving
+            // 0x1000's L2 set alone so random replacement cannot evict it there
+            unsigned long long addr = 0x100000 + i * 128;
+            if ((addr / L2_LINE_SIZE) % 256 == (0x1000 / L2_LINE_SIZE) % 256) continue;
+            tlc.memoryAccess(addr, read_ACCESS);
         }
 
         // Access original address - should be L1 miss, L2 hit
@@ -496,6 +1821,104 @@ private:
         return result;
     }
 
+    bool testRuntimeConfig() {
+        const string path = "config_test.cfg";
+        FILE *f = fopen(path.c_str(), "w");
+        fputs("# smaller, slower L2\nl2_size = 65536\nl2_hit_time=12  # cycles\n\nmem_ratio = 0.5\n", f);
+        fclose(f);
+        HierarchyConfig cfg;
+        string error;
+        bool parse_ok = cfg.load(path, error) && cfg.set("l1_assoc=3") && cfg.set("l1_size=12288") &&
+                        !cfg.set("l1_size=-1") && !cfg.set("l3_size=1") && !cfg.set("mem_ratio") &&
+                        cfg.l2_size == 65536 && cfg.l2_hit_time == 12 && cfg.l1_assoc == 3 &&
+                        cfg.memThreshold() == 0x7FFFFFFFu;
+        remove(path.c_str());
+        bool validate_ok = cfg.validate({16, 32, 64, 128}, error) && !cfg.validate({8192}, error);
+        // line x assoc past INT_MAX is rejected, not wrapped; sizes that are
+        // not whole KB print in bytes
+        HierarchyConfig huge;
+        ostringstream printed;
+        validate_ok = validate_ok && huge.set("l1_assoc=67108864") && huge.set("l1i_assoc=67108864") &&
+                      !huge.validate({64}, error) && huge.set("l1_assoc=4") && !huge.validate({64}, error);
+        huge.l2_size = 1536 * 64;
+        huge.l1_size = 1000 * 16;
+        huge.print(printed);
+        validate_ok = validate_ok && printed.str().rfind("L1 16000B 4-way", 0) == 0 &&
+                      printed.str().find("L2 96KB") != string::npos;
+
+        // Common geometries get a fixed-associativity kernel, others fall back
+        TwoLevelCache standard(64), odd(64, cfg);
+        Cache wide(64 * 1024, 64, 32, 1), uneven(3 * 64 * 64, 64, 4, 1);
+        bool kernel_ok = standard.getL1Cache()->getKernel() == KERNEL_POW2_A4 &&
+                         standard.getL2Cache()->getKernel() == KERNEL_POW2_A8 &&
+                         odd.getL1Cache()->getKernel() == KERNEL_GENERIC &&
+                         wide.getKernel() == KERNEL_POW2 && uneven.getKernel() == KERNEL_GENERIC;
+
+        // The generic 3-way L1 holds three lines per set and uses the new timings
+        int set_stride = 64 * odd.getL1Cache()->getNumSets();
+        for (int i = 0; i < 3; i++) odd.memoryAccess(0x100000 + i * set_stride, read_ACCESS);
+        int hit_cycles = 0;
+        for (int i = 0; i < 3; i++) hit_cycles += odd.memoryAccess(0x100000 + i * set_stride, read_ACCESS);
+        bool generic_ok = hit_cycles == 3 && odd.getL1Cache()->getHits() == 3 &&
+                          odd.memoryAccess(0x200000, read_ACCESS) == 1 + 12 + 50;
+
+        bool result = parse_ok && validate_ok && kernel_ok && generic_ok;
+        if (!result) {
+            cout << "    ⚠ Parse: " << parse_ok << ", Validate: " << validate_ok
+                 << ", Kernels: " << kernel_ok << ", Generic: " << generic_ok << " (" << error << ")\n";
+        }
+        return result;
+    }
+
+    bool testCheckpointRestore() {
+        const string path = "checkpoint_test.ckpt";
+        vector<unsigned> addrs;
+        for (int i = 0; i < 2000; i++) addrs.push_back(rand_() % (1024 * 1024));
+
+        TwoLevelCache warmed(64);
+        for (int i = 0; i < 20000; i++) {
+            warmed.memoryAccess(rand_() % (1024 * 1024), (i & 1) ? WRITE_ACCESS : read_ACCESS);
+        }
+        bool saved = warmed.saveCheckpoint(path);
+
+        unsigned long long original_cycles = 0;
+        for (unsigned addr : addrs) original_cycles += warmed.memoryAccess(addr, WRITE_ACCESS);
+
+        TwoLevelCache restored(64);
+        bool loaded = restored.restoreCheckpoint(path);
+        unsigned long long restored_cycles = 0;
+        for (unsigned addr : addrs) restored_cycles += restored.memoryAccess(addr, WRITE_ACCESS);
+
+        // A bandwidth-limited hierarchy charges its link only for the bytes
+        // moved after the restore, not for the checkpoint's history
+        HierarchyConfig limited_cfg;
+        limited_cfg.dram_bandwidth = 4;
+        TwoLevelCache limited(64, limited_cfg);
+        bool limited_loaded = limited.restoreCheckpoint(path);
+        const Cache *l2 = limited.getL2Cache();
+        unsigned long long before = l2->getFillBytes() + l2->getWritebackBytes();
+        for (unsigned addr : addrs) limited.memoryAccess(addr, WRITE_ACCESS);
+        double moved = (double)(l2->getFillBytes() + l2->getWritebackBytes() - before);
+        bool link_fresh = limited_loaded &&
+                          fabs(limited.getDramLink().getBusyCycles() - moved * limited_cfg.clock_ghz / limited_cfg.dram_bandwidth) < 1e-6;
+
+        TwoLevelCache mismatched(32);
+        bool rejected = !mismatched.restoreCheckpoint(path);
+        remove(path.c_str());
+
+        bool result = saved && loaded && rejected && link_fresh && original_cycles == restored_cycles &&
+                      warmed.getL2Cache()->getWritebacks() == restored.getL2Cache()->getWritebacks() &&
+                      warmed.getStores() == restored.getStores() &&
+                      warmed.getL2Cache()->getVictimWrites() == restored.getL2Cache()->getVictimWrites();
+
+        if (!result) {
+            cout << "    ⚠ Saved: " << saved << ", Loaded: " << loaded << ", Rejected mismatch: " << rejected
+                 << ", Cycles: " << original_cycles << " vs " << restored_cycles << ", DRAM link busy "
+                 << limited.getDramLink().getBusyCycles() << " for " << moved << " bytes\n";
+        }
+        return result;
+    }
+
     bool testMemGenPatterns() {
         // Reset generators for testing
         vector<unsigned> g1_vals, g4_vals;
@@ -539,6 +1962,217 @@ private:
         return result;
     }
 
+    bool testBulkGenerators() {
+        ScalarGenerator scalar[] = {memGen1, memGen4, memGen5};
+        BulkGenerator bulk[] = {bulkGen1, bulkGen4, bulkGen5};
+        unsigned long long out[BULK_BLOCK];
+        LaneRng rng(master_seed);
+        bool result = true;
+
+        // Deterministic generators must match their scalar versions exactly
+        for (int g = 0; g < 3 && result; g++) {
+            reset_generators();
+            vector<unsigned long long> expected;
+            for (int i = 0; i < 5000; i++) expected.push_back(scalar[g]());
+            reset_generators();
+            bulk[g](out, BULK_BLOCK, rng);
+            bulk[g](out, 5000 - BULK_BLOCK, rng);
+            for (int i = 0; i < 5000 - BULK_BLOCK; i++) {
+                if (out[i] != expected[BULK_BLOCK + i]) result = false;
+            }
+        }
+        if (!result) cout << "    ⚠ Bulk generator diverged from scalar pattern\n";
+
+        LaneRng a(master_seed), b(master_seed);
+        uint32_t ra[64], rb[64];
+        a.fill(ra, 64);
+        b.fill(rb, 64);
+        bulkGen2(out, 1000, a);
+        for (int i = 0; i < 1000; i++) {
+            if (out[i] >= 24 * 1024) {
+                result = false;
+                cout << "    ⚠ bulkGen2 exceeded 24KB range\n";
+                break;
+            }
+        }
+        if (memcmp(ra, rb, sizeof(ra)) != 0) {
+            result = false;
+            cout << "    ⚠ LaneRng is not reproducible\n";
+        }
+
+        // The expected CPI is for the default iterations and no warmup
+        CacheSimulator pinned(master_seed);
+        pinned.setConfig(HierarchyConfig());
+        seed_stream(master_seed, 3, 64, 0);
+        double cpi = pinned.run(bulkGen4, 64, 0);
+        if (fabs(cpi - 1.0038) > 0.001) {
+            result = false;
+            cout << "    ⚠ Block run CPI for memGen4 pattern: " << cpi << "\n";
+        }
+        return result;
+    }
+
+    bool testWorkloadGenerators() {
+        LaneRng rng(master_seed);
+        vector<unsigned long long> out(BULK_BLOCK);
+        bool result = true;
+
+        // Pointer chase: one lap visits every node exactly once
+        PointerChaseGenerator chase(64 * 1024, 64);
+        vector<bool> seen(chase.getNumNodes(), false);
+        chase.fill(out.data(), (int)chase.getNumNodes(), rng);
+        for (unsigned long long i = 0; i < chase.getNumNodes(); i++) seen[out[i] / 64] = true;
+        bool full_lap = chase.getNumNodes() == 1024 && count(seen.begin(), seen.end(), true) == 1024;
+
+        // Tiled GEMM: 2*n^3 operand reads plus one C access per (i, j, k-tile)
+        TiledMatmulGenerator gemm(16, 4);
+        unsigned long long expected = 2 * 16 * 16 * 16 + 16 * 16 * (16 / 4);
+        unsigned long long c_accesses = 0, in_bounds = 0;
+        vector<unsigned long long> gemm_out(expected);
+        for (unsigned long long done = 0; done < expected; done += BULK_BLOCK) {
+            gemm.fill(gemm_out.data() + done, (int)min<unsigned long long>(BULK_BLOCK, expected - done), rng);
+        }
+        for (unsigned long long a : gemm_out) {
+            if (a >= 2 * 16 * 16 * 8) c_accesses++;
+            if (a < gemm.getFootprint()) in_bounds++;
+        }
+        gemm.fill(out.data(), 1, rng);
+        bool gemm_ok = c_accesses == 16 * 16 * 4 && in_bounds == expected && out[0] == 0;
+
+        // Stencil: 5 reads + 1 write per interior point, all inside the grids
+        StencilGenerator stencil(8, 8);
+        stencil.fill(out.data(), 36 * 6, rng);
+        int writes = 0;
+        bool stencil_ok = true;
+        for (int i = 0; i < 36 * 6; i++) {
+            if (out[i] >= stencil.getFootprint()) stencil_ok = false;
+            if (out[i] >= 8 * 8 * 8) writes++;
+        }
+        stencil_ok = stencil_ok && writes == 36;
+        for (auto dims : {array<unsigned long long, 3>{2, 8, 1}, {8, 2, 1}, {8, 8, 2}, {8, 8, 0}}) {
+            try {
+                StencilGenerator bad(dims[0], dims[1], dims[2]);
+                stencil_ok = false;
+            } catch (const invalid_argument&) {
+            }
+        }
+
+        // Hash probes stay inside the table and probe consecutive buckets
+        HashProbeGenerator hash(1024 * 16, 16, 2);
+        hash.fill(out.data(), 1000, rng);
+        bool hash_ok = true;
+        for (int i = 0; i < 1000; i += 2) {
+            if (out[i] >= 1024 * 16 || (out[i + 1] != out[i] + 16 && out[i + 1] != 0)) hash_ok = false;
+        }
+
+        result = full_lap && gemm_ok && stencil_ok && hash_ok;
+        if (!result) {
+            cout << "    ⚠ Pointer chase: " << full_lap << ", GEMM: " << gemm_ok
+                 << ", Stencil: " << stencil_ok << ", Hash probe: " << hash_ok << "\n";
+        }
+        return result;
+    }
+
+    bool testWideAddresses() {
+        // Uniform generators reach the top half of the 64GB DRAM space
+        unsigned long long scalar_max = 0, bulk_max = 0;
+        bool in_range = true;
+        for (int i = 0; i < 10000; i++) {
+            unsigned long long a = memGen3();
+            scalar_max = max(scalar_max, a);
+            in_range = in_range && a < DRAM_SIZE;
+        }
+        LaneRng rng(derive_seed(master_seed, 42, 0, 0));
+        unsigned long long out[BULK_BLOCK];
+        bulkGen3(out, BULK_BLOCK, rng);
+        for (int i = 0; i < BULK_BLOCK; i++) {
+            bulk_max = max(bulk_max, out[i]);
+            in_range = in_range && out[i] < DRAM_SIZE;
+        }
+        bool dram_ok = in_range && scalar_max >= DRAM_SIZE / 2 && bulk_max >= DRAM_SIZE / 2;
+
+        // memGen1 wraps at DRAM_SIZE rather than at 4GB
+        unsigned long long saved = gen1_addr;
+        gen1_addr = DRAM_SIZE - 2;
+        bool wrap_ok = memGen1() == DRAM_SIZE - 2 && memGen1() == DRAM_SIZE - 1 && memGen1() == 0;
+        gen1_addr = saved;
+
+        // Library generators cover multi-TB footprints
+        const unsigned long long TB = 1ULL << 40;
+        HashProbeGenerator hash(4 * TB, 64, 1);
+        ZipfGenerator zipf(16 * TB, 64, 0.5);
+        HotColdGenerator hot_cold(4 * TB, 64, 1 << 20, 0.5);
+        WorkloadGenerator *wide[] = {&hash, &zipf, &hot_cold};
+        unsigned long long limits[] = {4 * TB, 16 * TB, 4 * TB};
+        bool tb_ok = true;
+        for (int g = 0; g < 3; g++) {
+            wide[g]->fill(out, BULK_BLOCK, rng);
+            unsigned long long top = *max_element(out, out + BULK_BLOCK);
+            tb_ok = tb_ok && top < limits[g] && top >= limits[g] / 2;
+        }
+
+        // Addresses above 4GB do not alias their low 32 bits in the caches
+        TwoLevelCache tlc(64);
+        tlc.memoryAccess(0x1000, read_ACCESS);
+        bool alias_ok = tlc.memoryAccess(0x100001000ULL, read_ACCESS) > 1 && tlc.memoryAccess(0x1000, read_ACCESS) == 1;
+
+        bool result = dram_ok && wrap_ok && tb_ok && alias_ok;
+        if (!result) {
+            cout << "    ⚠ DRAM: " << dram_ok << " (max " << scalar_max << "/" << bulk_max << "), Wrap: " << wrap_ok
+                 << ", TB: " << tb_ok << ", Alias: " << alias_ok << "\n";
+        }
+        return result;
+    }
+
+    bool testSkewedGenerators() {
+        LaneRng rng(master_seed);
+        vector<unsigned long long> out(BULK_BLOCK);
+        const int samples = 50 * BULK_BLOCK;
+
+        // Zipf(1.0) over 1000 items: P(rank 1) = 1 / H(1000) ~ 0.1336,
+        // and rank 2 is drawn half as often as rank 1
+        ZipfGenerator zipf(1000 * 64, 64, 1.0, false);
+        vector<int> counts(1000, 0);
+        for (int b = 0; b < samples / BULK_BLOCK; b++) {
+            zipf.fill(out.data(), BULK_BLOCK, rng);
+            for (int i = 0; i < BULK_BLOCK; i++) counts[out[i] / 64]++;
+        }
+        double p1 = (double)counts[0] / samples;
+        double ratio = (double)counts[0] / counts[1];
+        bool zipf_ok = fabs(p1 - 0.1336) < 0.005 && fabs(ratio - 2.0) < 0.1;
+
+        AliasTable table({0.5, 0.3, 0.2});
+        vector<int> picks(3, 0);
+        uint32_t r[2 * BULK_BLOCK];
+        for (int b = 0; b < 10; b++) {
+            rng.fill(r, 2 * BULK_BLOCK);
+            for (int i = 0; i < BULK_BLOCK; i++) picks[table.sample(r[2 * i], r[2 * i + 1])]++;
+        }
+        bool alias_ok = fabs(picks[0] / 40960.0 - 0.5) < 0.015 && fabs(picks[2] / 40960.0 - 0.2) < 0.015;
+
+        // Hot/cold over the full 64GB: ~90% of accesses land in the 64KB hot
+        // tier and the cold tier reaches beyond 4GB
+        HotColdGenerator hot_cold(DRAM_SIZE, 64, 64 * 1024, 0.9);
+        int hot = 0;
+        bool beyond_4gb = false, in_range = true;
+        for (int b = 0; b < 10; b++) {
+            hot_cold.fill(out.data(), BULK_BLOCK, rng);
+            for (int i = 0; i < BULK_BLOCK; i++) {
+                hot += out[i] < 64 * 1024;
+                beyond_4gb |= out[i] >= (1ULL << 32);
+                in_range &= out[i] < DRAM_SIZE;
+            }
+        }
+        bool hot_cold_ok = fabs(hot / 40960.0 - 0.9) < 0.015 && beyond_4gb && in_range;
+
+        bool result = zipf_ok && alias_ok && hot_cold_ok;
+        if (!result) {
+            cout << "    ⚠ Zipf P(1)=" << fixed << setprecision(4) << p1 << " ratio=" << ratio
+                 << ", Alias: " << alias_ok << ", Hot/cold: " << hot_cold_ok << "\n";
+        }
+        return result;
+    }
+
     bool testAccessPatterns() {
         TwoLevelCache tlc1(64), tlc2(64);
 
@@ -622,6 +2256,861 @@ private:
         return result;
     }
 
+    bool testFunctionalWarmup() {
+        // Random addresses, every other run of 32 replaced by a sequential
+        // walk that repeats lines
+        vector<unsigned> addrs;
+        unsigned run_base = 0;
+        for (int i = 0; i < 20000; i++) {
+            if (i % 32 == 0) run_base = rand_() % (256 * 1024);
+            addrs.push_back((i / 32) % 2 ? run_base + (i % 32) * 8 : rand_() % (256 * 1024));
+        }
+        unsigned int saved_w = m_w, saved_z = m_z;
+
+        // Warm path must leave the same tags, dirty bits and RNG state as
+        // the detailed path, while recording no statistics.
+        TwoLevelCache detailed(64), functional(64);
+        for (int i = 0; i < 20000; i++) detailed.memoryAccess(addrs[i], (i % 3) ? read_ACCESS : WRITE_ACCESS);
+        unsigned int detailed_w = m_w, detailed_z = m_z;
+        m_w = saved_w;
+        m_z = saved_z;
+        for (int i = 0; i < 20000; i++) functional.warmAccess(addrs[i], (i % 3) ? read_ACCESS : WRITE_ACCESS);
+        bool same_rng = (m_w == detailed_w) && (m_z == detailed_z);
+        bool no_stats = functional.getL1Cache()->getHits() + functional.getL1Cache()->getMisses() == 0;
+
+        unsigned long long detailed_cycles = 0, functional_cycles = 0;
+        unsigned int w = m_w, z = m_z;
+        for (int i = 0; i < 2000; i++) detailed_cycles += detailed.memoryAccess(addrs[i * 7], WRITE_ACCESS);
+        m_w = w;
+        m_z = z;
+        for (int i = 0; i < 2000; i++) functional_cycles += functional.memoryAccess(addrs[i * 7], WRITE_ACCESS);
+
+        // Once warmed, memGen4's 4KB working set never leaves L1
+        CacheSimulator pinned(master_seed);
+        pinned.setConfig(HierarchyConfig());
+        double cold_cpi = pinned.run(memGen4, 64, 0);
+        double warm_cpi = pinned.run(memGen4, 64, 100000);
+
+        // fastForward() makes the same draws as runDetailed(), so the stream
+        // and generator continue exactly where a detailed run leaves them
+        TwoLevelCache ran(64), skipped(64);
+        seed_random(master_seed);
+        runDetailed(memGen2, ran, 50000);
+        unsigned int ran_w = m_w, ran_z = m_z;
+        unsigned long long ran_cycles = runDetailed(memGen2, ran, 20000);
+        seed_random(master_seed);
+        fastForward(memGen2, skipped, 50000);
+        bool same_stream = m_w == ran_w && m_z == ran_z && runDetailed(memGen2, skipped, 20000) == ran_cycles;
+
+        // The warmup key covers trace replay: warmed records are not counted
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.warmup = 15000;
+        sim.setConfig(cfg);
+        const string path = "warmup_test.trc";
+        TraceWriter writer;
+        bool written = writer.open(path);
+        for (int i = 0; i < 20000 && written; i++) written = writer.append(addrs[i], (i % 3) ? read_ACCESS : WRITE_ACCESS);
+        written = writer.close() && written;
+        TraceReader reader;
+        TwoLevelCache traced(64, cfg);
+        bool trace_warmup = written && reader.open(path) && sim.replayTrace(reader, traced) > 0 &&
+                            traced.getL1Cache()->getHits() + traced.getL1Cache()->getMisses() == 5000;
+        remove(path.c_str());
+
+        bool result = same_rng && no_stats && detailed_cycles == functional_cycles &&
+                      warm_cpi < cold_cpi && warm_cpi == 1.0 && same_stream && trace_warmup;
+
+        if (!result) {
+            cout << "    ⚠ Same RNG: " << same_rng << ", No stats: " << no_stats
+                 << ", Cycles: " << detailed_cycles << " vs " << functional_cycles
+                 << ", CPI cold/warm: " << cold_cpi << "/" << warm_cpi << ", Same stream: " << same_stream
+                 << ", Trace warmup: " << trace_warmup << "\n";
+        }
+        return result;
+    }
+
+    bool testSampledRun() {
+        // memGen5 thrashes L1/L2 periodically, so sampling must converge on
+        // the full-run CPI and meet the requested error bound.
+        SamplingConfig cfg;
+        cfg.initial_samples = 20;
+        cfg.target_error = 0.02;
+        double full_cpi = run(bulkGen5, 64);
+        SampledResult sampled = runSampled(bulkGen5, 64, cfg);
+        double deviation = fabs(sampled.cpi - full_cpi) / full_cpi;
+
+        // A stream shorter than two units is rejected, not sampled
+        SamplingConfig tiny = cfg;
+        tiny.total_instructions = 2 * (cfg.unit_size + cfg.detailed_warmup) - 1;
+        bool rejected = runSampled(bulkGen5, 64, tiny).samples == 0;
+
+        bool result = sampled.relative_error <= cfg.target_error && deviation < 0.05 && rejected;
+
+        cout << "    Full CPI: " << fixed << setprecision(4) << full_cpi
+             << ", Sampled: " << sampled.cpi << " ± " << sampled.ci_half_width
+             << " (" << sampled.samples << " samples, " << sampled.rounds << " rounds)\n";
+        if (!rejected) cout << "    ⚠ A stream shorter than two units was sampled\n";
+
+        return result;
+    }
+
+    bool testSeededRuns() {
+        seed_stream(master_seed, 2, 64, 0);
+        double first = run(memGen3, 64);
+        seed_stream(master_seed, 2, 64, 0);
+        double repeat = run(memGen3, 64);
+        seed_stream(master_seed, 2, 64, 1);
+        double replicate = run(memGen3, 64);
+
+        bool result = (first == repeat) && (first != replicate) &&
+                      derive_seed(master_seed, 0, 16, 0) != derive_seed(master_seed, 0, 32, 0);
+
+        if (!result) {
+            cout << "    ⚠ Same stream: " << first << " vs " << repeat
+                 << ", other replicate: " << replicate << "\n";
+        }
+        return result;
+    }
+
+    bool testTraceRoundTrip() {
+        const string path = "trace_test.trc";
+        TiledMatmulGenerator gemm(64, 16);
+        LaneRng rng(master_seed);
+        vector<unsigned long long> addrs(150000);
+        vector<unsigned char> writes(addrs.size());
+        for (size_t i = 0; i < addrs.size(); i += BULK_BLOCK) {
+            gemm.fill(addrs.data() + i, (int)min<size_t>(BULK_BLOCK, addrs.size() - i), rng);
+        }
+        // Mix in far jumps and 64-bit addresses
+        for (size_t i = 0; i < addrs.size(); i += 97) addrs[i] = (((unsigned long long)rand_() << 24) ^ rand_()) % (1ULL << 40);
+        for (size_t i = 0; i < addrs.size(); i++) writes[i] = (unsigned char)(rand_() & 1);
+
+        TraceWriter writer;
+        bool written = writer.open(path, 10000);
+        for (size_t i = 0; i < addrs.size() && written; i++) {
+            written = writer.append(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+        }
+        written = writer.close() && written;
+
+        TraceReader reader;
+        bool opened = reader.open(path);
+        vector<unsigned long long> got(addrs.size());
+        vector<unsigned char> got_writes(addrs.size());
+        size_t decoded = 0;
+        int n;
+        while (opened && (n = reader.next(got.data() + decoded, got_writes.data() + decoded, 4096)) > 0) decoded += n;
+        bool same = decoded == addrs.size() && got == addrs && got_writes == writes;
+
+        unsigned long long addr;
+        unsigned char write;
+        bool seek_ok = reader.seek(123457) && reader.next(&addr, &write, 1) == 1 &&
+                       addr == addrs[123457] && write == writes[123457];
+
+        FILE *f = fopen(path.c_str(), "rb");
+        fseek(f, 0, SEEK_END);
+        double bytes_per_record = (double)ftell(f) / addrs.size();
+        fclose(f);
+
+        // Malformed blocks: a varint longer than 10 bytes, one cut off by
+        // the end of its payload, and more records than payload bytes
+        auto decodes = [&](uint32_t records, vector<unsigned char> payload, int& got_records) {
+            TraceFileHeader header = {};
+            memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+            header.version = TRACE_VERSION;
+            TraceBlockHeader block = {};
+            block.record_count = records;
+            block.payload_bytes = (uint32_t)payload.size();
+            FILE *out = fopen(path.c_str(), "wb");
+            fwrite(&header, sizeof(header), 1, out);
+            fwrite(&block, sizeof(block), 1, out);
+            fwrite(payload.data(), 1, payload.size(), out);
+            fclose(out);
+            TraceReader bad;
+            if (!bad.open(path)) return false;
+            unsigned long long a[4];
+            unsigned char w[4];
+            got_records = bad.next(a, w, 4);
+            return !bad.isCorrupt();
+        };
+        vector<unsigned char> overlong(11, 0xFF);
+        overlong.push_back(0x00);
+        int got_overlong = -1, got_cut = -1, got_short = -1;
+        bool rejected = !decodes(2, overlong, got_overlong) && got_overlong == 0 &&
+                        !decodes(2, {0x02, 0x80}, got_cut) && got_cut == 1 &&
+                        !decodes(3, {0x02, 0x04}, got_short) && got_short == -1;
+        remove(path.c_str());
+
+        bool result = written && opened && same && seek_ok && bytes_per_record < 2.0 && rejected;
+        cout << "    Encoded size: " << fixed << setprecision(2) << bytes_per_record << " bytes/record\n";
+        if (!result) {
+            cout << "    ⚠ Written: " << written << ", Opened: " << opened
+                 << ", Round trip: " << same << ", Seek: " << seek_ok << ", Malformed rejected: " << rejected << "\n";
+        }
+        return result;
+    }
+
+    bool testCoreModel() {
+        // Independent single-cycle instructions retire issue_width per cycle
+        HierarchyConfig cfg;
+        cfg.iterations = 200000;
+        CoreModel alu(cfg, cfg.l1_hit_time);
+        for (int i = 0; i < 4000; i++) alu.nonMemory();
+        bool width = alu.getCycles() == 1000;
+
+        // A one-entry, one-wide core is the in-order model except that
+        // stores drain in the background; a wide core overlaps misses, and
+        // load dependencies serialize them again
+        auto cpiOn = [&](int rob, int issue, int lsq, double dependency, unique_ptr<CoreModel>& core) {
+            HierarchyConfig c = cfg;
+            c.rob_size = rob;
+            c.issue_width = issue;
+            c.lsq_size = lsq;
+            c.load_dependency = dependency;
+            CacheSimulator sim(master_seed);
+            sim.setConfig(c);
+            auto workloads = sim.defaultWorkloads();
+            seed_stream(master_seed, 1, 64, 0);
+            TwoLevelCache cache(64, c);
+            core = make_unique<CoreModel>(c, c.l1_hit_time);
+            return sim.runOoO(*workloads[1], cache, *core);
+        };
+        CacheSimulator reference(master_seed);
+        reference.setConfig(cfg);
+        auto workloads = reference.defaultWorkloads();
+        seed_stream(master_seed, 1, 64, 0);
+        double in_order = reference.run(*workloads[1], 64);
+        unique_ptr<CoreModel> narrow, wide, chained;
+        double narrow_cpi = cpiOn(1, 1, 1, 0.0, narrow);
+        double wide_cpi = cpiOn(128, 4, 48, 0.0, wide);
+        double chained_cpi = cpiOn(128, 4, 48, 1.0, chained);
+        unsigned long long counted = 0;
+        for (int b = 0; b < MLP_BUCKETS; b++) counted += wide->getMLPHistogram()[b];
+
+        bool ordering = narrow_cpi <= in_order && narrow_cpi > 0.9 * in_order &&
+                        wide_cpi < narrow_cpi / 3 && chained_cpi > 1.5 * wide_cpi;
+        bool mlp = counted == wide->getMisses() && wide->getMisses() > 0 && narrow->getMeanMLP() <= 2.0 &&
+                   wide->getMeanMLP() > 2.0 && chained->getMeanMLP() < wide->getMeanMLP();
+        bool result = width && ordering && mlp;
+        if (!result) {
+            cout << "    ⚠ Width: " << width << ", CPI in-order " << in_order << ", narrow " << narrow_cpi << ", wide "
+                 << wide_cpi << ", chained " << chained_cpi << ", MLP narrow/wide/chained " << narrow->getMeanMLP()
+                 << "/" << wide->getMeanMLP() << "/" << chained->getMeanMLP() << "\n";
+        }
+        return result;
+    }
+
+    bool testInstructionFetch() {
+        // The code walk stays inside its footprint on instruction boundaries
+        CodeWalkGenerator walk(64 * 1024);
+        LaneRng rng(derive_seed(master_seed, 9, 0, 0));
+        vector<unsigned long long> pcs(BULK_BLOCK);
+        walk.fill(pcs.data(), BULK_BLOCK, rng);
+        bool bounded = true;
+        for (auto pc : pcs) bounded = bounded && pc >= CODE_BASE && pc < CODE_BASE + 64 * 1024 && pc % 4 == 0;
+        try {
+            CodeWalkGenerator tiny(64 * 1024, 8);
+            bounded = false;
+        } catch (const invalid_argument&) {
+        }
+
+        // The shadow L2s draw from their own streams: on data alone the
+        // shared L2 evicts exactly what TwoLevelCache's L2 does
+        vector<uint32_t> draws(50000);
+        rng.fill(draws.data(), (int)draws.size());
+        HierarchyConfig plain;
+        TwoLevelCache reference(64, plain);
+        SplitL1Hierarchy split(64, plain);
+        vector<int> expected, got;
+        seed_random(master_seed);
+        for (uint32_t d : draws) expected.push_back(reference.memoryAccess((d & 0xFFFFF) * 8ULL, (accessType)(d >> 31)));
+        seed_random(master_seed);
+        for (uint32_t d : draws) got.push_back(split.memoryAccess((d & 0xFFFFF) * 8ULL, (accessType)(d >> 31)));
+        bool isolated = got == expected;
+
+        // Code that fits the L1I only misses cold and leaves data alone; a
+        // large-code service misses in L1I and L2 and pushes data out of L2
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 200000;
+        sim.setConfig(cfg);
+        auto workloads = sim.defaultWorkloads();
+        FetchResult small = sim.runFetch(*workloads[11], 11, 8 * 1024);
+        FetchResult large = sim.runFetch(*workloads[11], 11, 4 << 20);
+        bool fits = small.l1i_mpki < 1.0 && fabs(small.inst_on_data) < 2.0 &&
+                    small.cpi - small.cpi_no_fetch < 0.025 * small.cpi;
+        bool spills = large.l1i_mpki > 20 && large.l2_inst_mpki > 10 && large.inst_on_data > 5 &&
+                      large.cpi > small.cpi + 1.0 && large.cpi_no_fetch == small.cpi_no_fetch;
+
+        bool result = bounded && isolated && fits && spills;
+        if (!result) {
+            cout << "    ⚠ Bounded: " << bounded << ", Shadow streams isolated: " << isolated << ", L1I MPKI small/large " << small.l1i_mpki << "/" << large.l1i_mpki
+                 << ", I->D small/large " << small.inst_on_data << "/" << large.inst_on_data << ", CPI "
+                 << small.cpi_no_fetch << "/" << small.cpi << "/" << large.cpi << "\n";
+        }
+        return result;
+    }
+
+    bool testLibraryApi() {
+        const size_t n = 100000;
+        LaneRng rng(derive_seed(master_seed, 10, 0, 0));
+        vector<uint32_t> draws(n);
+        rng.fill(draws.data(), (int)n);
+        vector<uint64_t> addrs(n);
+        vector<uint8_t> writes(n);
+        for (size_t i = 0; i < n; i++) {
+            addrs[i] = draws[i] & 0x3FFFF;
+            writes[i] = (uint8_t)(draws[i] >> 31);
+        }
+
+        // The span API matches TwoLevelCache access for access when both
+        // draw victims from the same stream
+        seed_random(42);
+        TwoLevelCache reference(32);
+        vector<uint32_t> expected(n);
+        for (size_t i = 0; i < n; i++) expected[i] = reference.memoryAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+        cachesim::Config cfg;
+        cfg.l1_line_size = 32;
+        auto lib = cachesim::Hierarchy::create(cfg);
+        lib->seed(42);
+        vector<uint32_t> cycles(n);
+        uint64_t total = lib->access(span<const uint64_t>(addrs).first(n / 2), span<const uint8_t>(writes).first(n / 2),
+                                     span<uint32_t>(cycles).first(n / 2));
+        total += lib->access(span<const uint64_t>(addrs).subspan(n / 2), span<const uint8_t>(writes).subspan(n / 2),
+                             span<uint32_t>(cycles).subspan(n / 2));
+        cachesim::Stats st = lib->stats();
+        bool same = cycles == expected && st.cycles == total && st.accesses == n &&
+                    st.l1.hits == reference.getL1Cache()->getHits() && st.l2.misses == reference.getL2Cache()->getMisses() &&
+                    st.l1.writebacks == reference.getL1Cache()->getWritebacks() &&
+                    st.averageAccessTime() == reference.getAverageAccessTime();
+
+        // The C ABI drives the same engine; bad geometries are refused
+        cachesim_config c;
+        cachesim_default_config(&c);
+        c.l1_line_size = 32;
+        char error[128] = "";
+        cachesim_hierarchy *h = cachesim_create(&c, error, sizeof(error));
+        cachesim_seed(h, 42);
+        uint64_t c_total = cachesim_access(h, addrs.data(), writes.data(), n, nullptr);
+        cachesim_stats cs;
+        cachesim_get_stats(h, &cs);
+        cachesim_destroy(h);
+        c.l1_size = 1000;
+        bool refused = cachesim_create(&c, error, sizeof(error)) == nullptr && strlen(error) > 0;
+        // line x assoc past INT_MAX is refused, and no call crashes on NULL
+        cachesim_default_config(&c);
+        c.l1_assoc = 1 << 28;
+        refused = refused && cachesim_create(&c, error, sizeof(error)) == nullptr &&
+                  cachesim_create(nullptr, nullptr, 0) == nullptr &&
+                  cachesim_access(nullptr, addrs.data(), nullptr, 1, nullptr) == CACHESIM_ERROR &&
+                  cachesim_get_stats(nullptr, &cs) == -1 && cachesim_seed(nullptr, 1) == -1;
+        bool c_api = c_total == total && cs.l2.hits == st.l2.hits && refused;
+
+        bool result = same && c_api;
+        if (!result) {
+            cout << "    ⚠ Span API matches: " << same << ", C total " << c_total << " vs " << total
+                 << ", Refused: " << refused << " (" << error << ")\n";
+        }
+        return result;
+    }
+
+    bool testSectoredCache() {
+        // Direct-mapped 1KB, 64B lines in 16B sectors: sector misses on a
+        // resident tag fill one sector and evict nothing
+        Cache c(1024, 64, 1, 1, 16);
+        c.access(0, read_ACCESS);
+        c.access(16, read_ACCESS);
+        c.access(40, WRITE_ACCESS);
+        bool hit = c.access(4, read_ACCESS).first == HIT;
+        auto conflict = c.access(1024, read_ACCESS);
+        bool fills = c.getMisses() == 4 && c.getSectorMisses() == 2 && c.getFillBytes() == 4 * 16 && hit;
+        bool writeback = conflict.second && c.getWritebacks() == 1 && c.getWritebackBytes() == 16 &&
+                         c.access(16, read_ACCESS).first == MISS;
+
+        // An L2 in 16B sectors fills every sector an L1 fill covers: both
+        // halves of a 64B line for two 32B L1 lines, all four for one 64B
+        HierarchyConfig sectored;
+        sectored.l2_line_size = 64;
+        sectored.l2_sector_size = 16;
+        TwoLevelCache narrow(32, sectored), wide(64, sectored);
+        narrow.memoryAccess(0x20, read_ACCESS);
+        narrow.memoryAccess(0x00, read_ACCESS);
+        bool narrow_hit = narrow.memoryAccess(0x10, read_ACCESS) == sectored.l1_hit_time;
+        wide.memoryAccess(0x00, read_ACCESS);
+        const Cache &n2 = *narrow.getL2Cache(), &w2 = *wide.getL2Cache();
+        bool covered = n2.getMisses() == 2 && n2.getSectorMisses() == 1 && n2.getFillBytes() == 64 && narrow_hit &&
+                       w2.getMisses() == 1 && w2.getFillBytes() == 64;
+
+        // Over a random-access workload, sectoring cuts L1 <-> L2 traffic at
+        // the cost of per-sector state bits
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 50000;
+        double bytes[2];
+        unsigned long long meta[2];
+        for (int s = 0; s < 2; s++) {
+            cfg.l1_sector_size = s ? 16 : 0;
+            sim.setConfig(cfg);
+            seed_stream(master_seed, 11, 64, 0);
+            TwoLevelCache cache(64, cfg);
+            HashProbeGenerator gen(1ULL << 24, 64);
+            sim.runOn(gen, cache);
+            const Cache& l1 = *cache.getL1Cache();
+            bytes[s] = (double)(l1.getFillBytes() + l1.getWritebackBytes());
+            meta[s] = l1.metadataBits(36);
+        }
+        bool traffic = bytes[1] < bytes[0] / 2 && meta[1] > meta[0];
+
+        bool result = fills && writeback && covered && traffic;
+        if (!result) {
+            cout << "    ⚠ Misses " << c.getMisses() << " (sector " << c.getSectorMisses() << "), fill/writeback bytes "
+                 << c.getFillBytes() << "/" << c.getWritebackBytes() << ", L2 fill bytes under 32B/64B L1 lines "
+                 << n2.getFillBytes() << "/" << w2.getFillBytes() << ", L1 bytes " << bytes[0] << " -> " << bytes[1]
+                 << ", tag bits " << meta[0] << " -> " << meta[1] << "\n";
+        }
+        return result;
+    }
+
+    bool testBandwidthQueueing() {
+        // The same accesses move the same bytes at any bandwidth; a tighter
+        // DRAM link only adds queueing delay and runs hotter
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 100000;
+        double bandwidths[] = {0, 16, 2};
+        double cpi[3], util[3];
+        unsigned long long bytes[3], waits[3];
+        for (int b = 0; b < 3; b++) {
+            cfg.dram_bandwidth = bandwidths[b];
+            sim.setConfig(cfg);
+            seed_stream(master_seed, 12, 64, 0);
+            TwoLevelCache cache(64, cfg);
+            HashProbeGenerator gen(1ULL << 26, 64);
+            cpi[b] = sim.runOn(gen, cache);
+            const Cache& l2 = *cache.getL2Cache();
+            bytes[b] = l2.getFillBytes() + l2.getWritebackBytes();
+            util[b] = cache.linkUtilization(cache.getDramLink());
+            waits[b] = cache.getDramLink().getWaitCycles();
+        }
+        bool same_bytes = bytes[0] == bytes[1] && bytes[1] == bytes[2] && bytes[0] > 0;
+        bool slower = cpi[0] < cpi[1] && cpi[1] < cpi[2] && waits[0] == 0 && waits[1] < waits[2];
+        bool utilization = util[0] == 0 && util[1] < util[2] && util[2] < 1.0;
+
+        bool result = same_bytes && slower && utilization;
+        if (!result) {
+            cout << "    ⚠ DRAM bytes " << bytes[0] << "/" << bytes[1] << "/" << bytes[2] << ", CPI " << cpi[0] << "/"
+                 << cpi[1] << "/" << cpi[2] << ", utilization " << util[1] << "/" << util[2] << "\n";
+        }
+        return result;
+    }
+
+    bool testEnergyModel() {
+        // Table entries are used as is; other geometries scale from the
+        // nearest entry
+        EnergyModel model;
+        CacheEnergy l1 = model.lookup(16 * 1024, 4, 64), wide = model.lookup(16 * 1024, 4, 128);
+        bool table = l1.read == 8.0 && l1.tag == 1.5 && wide.read == 2 * l1.read && wide.leakage == l1.leakage;
+
+        // Repeated loads of one line: one L1 fill, L2 read and DRAM line, and
+        // a tag lookup plus line read per access
+        TwoLevelCache cache(64);
+        for (int i = 0; i < 100; i++) cache.memoryAccess(0x1000, read_ACCESS);
+        EnergyBreakdown e = model.measure(cache, 1.0);
+        CacheEnergy l2 = model.lookup(L2_CACHE_SIZE, L2_ASSOCIATIVITY, L2_LINE_SIZE);
+        const DramEnergy& d = model.getDram();
+        double cycles = (double)cache.getElapsedCycles();
+        bool counted = fabs(e.l1 - (100 * (l1.tag + l1.read) + l1.write)) < 1e-6 &&
+                       fabs(e.l2 - (l2.tag + l2.read + l2.write)) < 1e-6 &&
+                       fabs(e.dram - (d.activate + d.read)) < 1e-6 &&
+                       fabs(e.leakage - (l1.leakage + l2.leakage) * cycles) < 1e-6;
+
+        // Stores over twice the L2: dirty L1 victims are written into L2,
+        // which writes them back to DRAM, so DRAM write energy is charged
+        // and the run costs more DRAM energy than loads of the same lines
+        EnergyBreakdown moved[2];
+        unsigned long long l2_writebacks[2];
+        for (int w = 0; w < 2; w++) {
+            seed_random(master_seed);
+            TwoLevelCache run(64);
+            for (unsigned long long a = 0; a < 2ULL * L2_CACHE_SIZE; a += 64) run.memoryAccess(a, w ? WRITE_ACCESS : read_ACCESS);
+            moved[w] = model.measure(run, 1.0);
+            l2_writebacks[w] = run.getL2Cache()->getWritebacks();
+        }
+        double write_energy = l2_writebacks[1] * d.write;
+        bool written = l2_writebacks[0] == 0 && l2_writebacks[1] > 0 && moved[1].dram > moved[0].dram + write_energy;
+
+        // Stores over twice the L1 but within the L2: each dirty L1 victim
+        // costs one L2 lookup and line write, and nothing at DRAM
+        TwoLevelCache installs(64);
+        for (unsigned long long a = 0; a < 2ULL * L1_CACHE_SIZE; a += 64) installs.memoryAccess(a, WRITE_ACCESS);
+        EnergyBreakdown v = model.measure(installs, 1.0);
+        double fills = (double)installs.getL2Cache()->getMisses();
+        double victims = (double)installs.getL2Cache()->getVictimWrites();
+        bool installed = victims > 0 && victims == installs.getL1Cache()->getWritebacks() &&
+                         fabs(v.l2 - ((fills + victims) * l2.tag + fills * (l2.read + l2.write) + victims * l2.write)) < 1e-6 &&
+                         fabs(v.dram - fills * (d.activate + d.read)) < 1e-6;
+
+        // A loaded table replaces the built-in one; bad entries are refused
+        string path = "energy_test.txt", error;
+        FILE *f = fopen(path.c_str(), "w");
+        fprintf(f, "# size assoc line read write tag leakage\ncache 16384 4 64 1 2 0.5 0\ndram 10 20 30\n");
+        fclose(f);
+        bool loaded = model.load(path, error) && model.lookup(16 * 1024, 4, 64).read == 1 &&
+                      model.lookup(128 * 1024, 8, 64).leakage == 0 && model.getDram().write == 30;
+        f = fopen(path.c_str(), "w");
+        fprintf(f, "cache 16384 4\n");
+        fclose(f);
+        bool refused = !model.load(path, error) && model.getDram().write == 30;
+        remove(path.c_str());
+
+        bool result = table && counted && written && installed && loaded && refused;
+        if (!result) {
+            cout << "    ⚠ Table: " << table << ", L1/L2/DRAM/leakage " << e.l1 << "/" << e.l2 << "/" << e.dram << "/"
+                 << e.leakage << ", L2 writebacks " << l2_writebacks[1] << ", DRAM pJ loads/stores " << moved[0].dram
+                 << "/" << moved[1].dram << ", Victim installs " << victims << " (L2/DRAM pJ " << v.l2 << "/" << v.dram
+                 << "), Loaded: " << loaded << ", Refused: " << refused << " (" << error << ")\n";
+        }
+        return result;
+    }
+
+    bool testForkedGrid() {
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 20000;
+        sim.setConfig(cfg);
+        auto workloads = sim.defaultWorkloads();
+        int line_sizes[] = {16, 32, 64, 128};
+
+        // The first worker to claim slot 5 is killed; the slot is retried
+        vector<vector<double>> forked(workloads.size(), vector<double>(4));
+        ForkStats stats;
+#ifndef _WIN32
+        sim.setForkPointHook([](int slot, int attempt) {
+            if (slot == 5 && attempt == 0) kill(getpid(), SIGKILL);
+        });
+#endif
+        bool ok = sim.runForkedGrid(3, forked, stats);
+        bool same = true;
+        PipelineStats unused;
+        for (int g = 0; g < (int)workloads.size(); g++) {
+            for (int l = 0; l < 4; l++) same = same && forked[g][l] == sim.runGridPoint(*workloads[g], g, line_sizes[l], unused);
+        }
+
+        bool result = ok && same && stats.crashes == 1 && stats.failed_slots == 0 && stats.workers_started >= 4;
+        if (!result) {
+            cout << "    ⚠ OK: " << ok << ", Same as serial: " << same << ", Crashes: " << stats.crashes
+                 << ", Workers: " << stats.workers_started << ", Failed: " << stats.failed_slots << "\n";
+        }
+        return result;
+    }
+
+    bool testEventEngine() {
+        // Events fire in time order, FIFO within a cycle, across every
+        // wheel level and the overflow list
+        struct Recorder : SimComponent {
+            vector<pair<unsigned long long, uint32_t>> fired;
+            void handle(EventEngine& engine, SimMessage& msg) override { fired.push_back({engine.getNow(), msg.id}); }
+        } recorder;
+        EventEngine engine;
+        unsigned long long delays[] = {5, 0, 300, 5, 70000, 255, 256, 1ULL << 25, 1ULL << 33, 65535, 5};
+        SimMessage msg;
+        for (uint32_t i = 0; i < 11; i++) {
+            msg.id = i;
+            engine.schedule(delays[i], &recorder, msg);
+        }
+        engine.run();
+        bool ordered = recorder.fired.size() == 11 && engine.getPending() == 0;
+        for (size_t i = 0; ordered && i < recorder.fired.size(); i++) {
+            ordered = recorder.fired[i].first == delays[recorder.fired[i].second] &&
+                      (i == 0 || recorder.fired[i - 1].first < recorder.fired[i].first ||
+                       recorder.fired[i - 1].second < recorder.fired[i].second);
+        }
+
+        // With one access outstanding the components reproduce memoryAccess
+        const int n = 100000;
+        LaneRng rng(derive_seed(master_seed, 8, 0, 0));
+        vector<uint32_t> draws(n);
+        rng.fill(draws.data(), n);
+        vector<unsigned long long> addrs(n);
+        vector<unsigned char> writes(n);
+        for (int i = 0; i < n; i++) {
+            addrs[i] = draws[i] & 0xFFFFF;
+            writes[i] = (unsigned char)(draws[i] >> 31);
+        }
+        seed_stream(master_seed, 8, 64, 0);
+        TwoLevelCache serial(64);
+        unsigned long long serial_cycles = 0;
+        for (int i = 0; i < n; i++) serial_cycles += serial.memoryAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+        seed_stream(master_seed, 8, 64, 0);
+        EventRunStats blocking = runEventDriven(addrs.data(), writes.data(), n, 64, HierarchyConfig(), 1);
+        bool exact = blocking.total_latency == serial_cycles && blocking.finish_time == serial_cycles;
+
+        // More outstanding accesses overlap misses; a busy DRAM channel queues them
+        seed_stream(master_seed, 8, 64, 0);
+        EventRunStats overlapped = runEventDriven(addrs.data(), writes.data(), n, 64, HierarchyConfig(), 8);
+        seed_stream(master_seed, 8, 64, 0);
+        EventRunStats queued = runEventDriven(addrs.data(), writes.data(), n, 64, HierarchyConfig(), 8, 40);
+        bool overlap = overlapped.finish_time < blocking.finish_time / 4 &&
+                       queued.total_latency > overlapped.total_latency &&
+                       queued.finish_time > overlapped.finish_time;
+
+        bool result = ordered && exact && overlap;
+        if (!result) {
+            cout << "    ⚠ Ordered: " << ordered << ", Blocking " << blocking.total_latency << " vs serial "
+                 << serial_cycles << ", Finish window 1/8/queued " << blocking.finish_time << "/"
+                 << overlapped.finish_time << "/" << queued.finish_time << "\n";
+        }
+        return result;
+    }
+
+    bool testShardedHierarchy() {
+        const int n = 200000;
+        LaneRng rng(derive_seed(master_seed, 7, 0, 0));
+        vector<uint32_t> draws(n);
+        rng.fill(draws.data(), n);
+        vector<unsigned long long> addrs(n);
+        vector<unsigned char> writes(n);
+        for (int i = 0; i < n; i++) {
+            addrs[i] = (draws[i] & 0x7FFFF) + (i % 3 == 0 ? 0x100000000ULL : 0);
+            writes[i] = (unsigned char)(draws[i] >> 31);
+        }
+
+        // Direct-mapped levels draw no victims, so sharding must be exact,
+        // including per-access cycles across uneven chunk boundaries
+        HierarchyConfig direct;
+        direct.l1_assoc = direct.l2_assoc = 1;
+        TwoLevelCache serial(32, direct);
+        ShardedHierarchy sharded(32, direct, 4, master_seed);
+        vector<uint32_t> cycles(n);
+        sharded.access(addrs.data(), writes.data(), 12345, cycles.data());
+        sharded.access(addrs.data() + 12345, writes.data() + 12345, n - 12345, cycles.data() + 12345);
+        bool exact = sharded.getShards() == 4;
+        for (int i = 0; i < n && exact; i++) {
+            exact = cycles[i] == (uint32_t)serial.memoryAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+        }
+        exact = exact && sharded.getL1Cache().getHits() == serial.getL1Cache()->getHits() &&
+                sharded.getL2Cache().getMisses() == serial.getL2Cache()->getMisses() &&
+                sharded.getL1Cache().getWritebacks() == serial.getL1Cache()->getWritebacks() &&
+                sharded.getAverageAccessTime() == serial.getAverageAccessTime();
+
+        // Random replacement: per-shard RNG streams, statistically equal
+        TwoLevelCache serial_random(64);
+        ShardedHierarchy sharded_random(64, HierarchyConfig(), 8, master_seed);
+        for (int i = 0; i < n; i++) serial_random.memoryAccess(addrs[i], writes[i] ? WRITE_ACCESS : read_ACCESS);
+        sharded_random.access(addrs.data(), writes.data(), n);
+        double a = serial_random.getAverageAccessTime(), b = sharded_random.getAverageAccessTime();
+        bool close = fabs(a - b) / a < 0.02;
+
+        // Shard count is clamped to a divisor of both levels' set counts
+        bool clamp = ShardedHierarchy(128, HierarchyConfig(), 1000, 1).getShards() == 32 &&
+                     ShardedHierarchy(64, HierarchyConfig(), 6, 1).getShards() == 4;
+
+        bool result = exact && close && clamp;
+        if (!result) {
+            cout << "    ⚠ Exact: " << exact << ", Random AMAT serial " << a << " vs sharded " << b
+                 << ", Clamp: " << clamp << "\n";
+        }
+        return result;
+    }
+
+    bool testReplicates() {
+        double sample[] = {1.0, 2.0, 3.0};
+        ReplicateStats st = ReplicateStats::of(sample, 3);
+        bool stats_ok = st.mean == 2.0 && fabs(st.stddev - 1.0) < 1e-12 &&
+                        fabs(st.ci_half_width - 4.303 / sqrt(3.0)) < 1e-9 &&
+                        tCritical95(10) == 2.228 && tCritical95(1000) == 1.960;
+
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 50000;
+        sim.setConfig(cfg);
+        vector<pair<int, int>> points = {{1, 64}, {2, 64}, {3, 64}};
+        ReplicateConfig fixed_count;
+        fixed_count.max_replicates = 5;
+        ReplicateConfig early;
+        early.max_replicates = 12;
+        early.target_half_width = 0.05;
+
+        vector<ReplicateStats> all = sim.runReplicates(points, fixed_count, 2);
+        vector<ReplicateStats> serial = sim.runReplicates(points, early, 1);
+        vector<ReplicateStats> parallel = sim.runReplicates(points, early, 3);
+
+        // Without a target every point gets max_replicates; replicate 0 is the single-run stream
+        seed_stream(master_seed, 1, 64, 0);
+        BulkWorkload gen2("memGen2", bulkGen2);
+        double single = sim.run(gen2, 64);
+        bool fixed_ok = all[0].replicates == 5 && all[2].replicates == 5 && all[0].stddev > 0 &&
+                        sim.runReplicates({{1, 64}}, ReplicateConfig(), 1)[0].mean == single;
+
+        // Early stopping: low-variance points stop at the minimum, noisy ones
+        // run longer, and the outcome is the same for any thread count
+        bool early_ok = serial[2].replicates == 3 && serial[1].replicates > serial[2].replicates;
+        for (size_t i = 0; i < points.size(); i++) {
+            early_ok = early_ok && serial[i].replicates == parallel[i].replicates && serial[i].mean == parallel[i].mean &&
+                       (serial[i].ci_half_width <= early.target_half_width || serial[i].replicates == early.max_replicates);
+        }
+
+        bool result = stats_ok && fixed_ok && early_ok;
+        if (!result) {
+            cout << "    ⚠ Stats: " << stats_ok << ", Fixed: " << fixed_ok << ", Early: " << early_ok
+                 << " (replicates " << serial[0].replicates << "/" << serial[1].replicates << "/"
+                 << serial[2].replicates << ")\n";
+        }
+        return result;
+    }
+
+    bool testDesignSpaceExploration() {
+        CacheSimulator sim(master_seed);
+        HierarchyConfig cfg;
+        cfg.iterations = 64000;
+        sim.setConfig(cfg);
+        DesignSpace space;
+        space.setRange("l1_size=8192,16384,32768");
+        space.setRange("l1_assoc=1,3,4");
+        space.setRange("l2_size=65536,262144");
+        bool range_ok = !space.setRange("mem_ratio=0.2,0.3") && !space.setRange("l1_line=") &&
+                        !space.setRange("l2_assoc=8,x");
+
+        DseResult serial = sim.exploreDesignSpace(space, 1, 1);
+        DseResult parallel = sim.exploreDesignSpace(space, 1, 3);
+        DseResult exhaustive = sim.exploreDesignSpace(space, 1, 2, 1);
+
+        // Identical frontier regardless of thread count
+        bool deterministic = serial.frontier.size() == parallel.frontier.size() && !serial.frontier.empty();
+        for (size_t i = 0; deterministic && i < serial.frontier.size(); i++) {
+            deterministic = serial.frontier[i].cpi == parallel.frontier[i].cpi &&
+                            serial.frontier[i].area_kb == parallel.frontier[i].area_kb;
+        }
+
+        // Frontier is sorted by area with falling CPI, and with common random
+        // numbers its full-length CPIs match the exhaustive run exactly
+        bool pareto_ok = serial.invalid == 6 && serial.rungs[0].first == 12 &&
+                         serial.simulated_instructions < exhaustive.simulated_instructions;
+        for (size_t i = 0; i < serial.frontier.size(); i++) {
+            const DesignPoint& p = serial.frontier[i];
+            if (i > 0) pareto_ok = pareto_ok && p.area_kb > serial.frontier[i - 1].area_kb && p.cpi < serial.frontier[i - 1].cpi;
+            bool matched = false;
+            for (const DesignPoint& e : exhaustive.frontier) {
+                matched |= e.area_kb == p.area_kb && e.cpi == p.cpi;
+            }
+            pareto_ok = pareto_ok && matched;
+        }
+
+        bool result = range_ok && deterministic && pareto_ok;
+        if (!result) {
+            cout << "    ⚠ Ranges: " << range_ok << ", Deterministic: " << deterministic
+                 << ", Pareto: " << pareto_ok << " (" << serial.frontier.size() << " frontier points, "
+                 << serial.invalid << " invalid)\n";
+        }
+        return result;
+    }
+
+    bool testPipelinedRun() {
+        StencilGenerator stencil(512, 512);
+        seed_stream(master_seed, 7, 32, 0);
+        double serial = run(stencil, 32);
+        seed_stream(master_seed, 7, 32, 0);
+        PipelineStats stats;
+        double piped = runPipelined(stencil, 32, stats);
+
+        // A limited DRAM link also sees the non-memory cycles on the
+        // consumer side, so its queueing delay matches the serial run
+        CacheSimulator limited(master_seed);
+        HierarchyConfig narrow;
+        narrow.dram_bandwidth = 2;
+        narrow.iterations = 200000;
+        limited.setConfig(narrow);
+        auto workloads = limited.defaultWorkloads();
+        seed_stream(master_seed, 0, 16, 0);
+        double limited_serial = limited.run(*workloads[0], 16);
+        seed_stream(master_seed, 0, 16, 0);
+        PipelineStats limited_stats;
+        double limited_piped = limited.runPipelined(*workloads[0], 16, limited_stats);
+
+        // Trace decoding on the producer side must replay identically
+        const string path = "pipeline_test.trc";
+        bool written = writeWorkloadTrace(stencil, path, 100000);
+        TraceReader serial_reader, piped_reader;
+        TwoLevelCache serial_cache(64), piped_cache(64);
+        PipelineStats trace_stats;
+        seed_random(master_seed);
+        unsigned long long serial_cycles = written && serial_reader.open(path) ? replayTrace(serial_reader, serial_cache) : 0;
+        seed_random(master_seed);
+        unsigned long long piped_cycles = written && piped_reader.open(path) ? replayTracePipelined(piped_reader, piped_cache, trace_stats) : 1;
+        remove(path.c_str());
+
+        unsigned long long expected_batches = (NO_OF_ITERATIONS + BULK_BLOCK - 1) / BULK_BLOCK;
+        bool result = serial == piped && stats.batches == expected_batches && limited_serial == limited_piped &&
+                      serial_cycles == piped_cycles && trace_stats.batches == (100000 + BULK_BLOCK - 1) / BULK_BLOCK;
+
+        if (!result) {
+            cout << "    ⚠ Serial CPI " << serial << " vs pipelined " << piped << ", limited DRAM link "
+                 << limited_serial << " vs " << limited_piped << ", batches " << stats.batches
+                 << ", trace cycles " << serial_cycles << " vs " << piped_cycles << "\n";
+        }
+        return result;
+    }
+
+    bool testTraceImporters() {
+        const string din_path = "import_test.din", lackey_path = "import_test.lackey";
+        const string champsim_path = "import_test.champsim", native_path = "import_test.trc";
+
+        FILE *f = fopen(din_path.c_str(), "w");
+        fputs("2 400100\n0 7fff0010\n1 7fff0018\n2 400104\n4 0\n-1 7fff0020\n0 deadbeef00\n", f);
+        fclose(f);
+        f = fopen(lackey_path.c_str(), "w");
+        fputs("==123== Lackey, an example Valgrind tool\nI  04000000,3\n L 0401c8f4,4\n S be80199c,4\n"
+              "I  04000003,2\n M 0025747c,1\n", f);
+        fclose(f);
+        ChampSimRecord records[2] = {};
+        records[0].ip = 0x400000;
+        records[0].source_memory[0] = 0x1000;
+        records[0].source_memory[2] = 0x2000;
+        records[1].ip = 0x400004;
+        records[1].destination_memory[1] = 0x3000;
+        f = fopen(champsim_path.c_str(), "wb");
+        fwrite(records, sizeof(records), 1, f);
+        fclose(f);
+
+        typedef vector<pair<unsigned long long, accessType>> Accesses;
+        auto collect = [](TraceFormat format, const string& path, Accesses& out, ImportStats& stats) {
+            return importTrace(format, path, [&](unsigned long long a, accessType t) { out.push_back({a, t}); }, stats);
+        };
+        Accesses din, lackey, champsim;
+        ImportStats din_stats, lackey_stats, champsim_stats;
+        bool din_ok = collect(DINERO_TRACE, din_path, din, din_stats) &&
+                      din == Accesses{{0x7fff0010, read_ACCESS}, {0x7fff0018, WRITE_ACCESS}, {0xdeadbeef00ULL, read_ACCESS}} &&
+                      din_stats.instructions == 2 && din_stats.skipped == 2;
+        bool lackey_ok = collect(LACKEY_TRACE, lackey_path, lackey, lackey_stats) &&
+                         lackey == Accesses{{0x0401c8f4, read_ACCESS}, {0xbe80199c, WRITE_ACCESS},
+                                            {0x0025747c, read_ACCESS}, {0x0025747c, WRITE_ACCESS}} &&
+                         lackey_stats.instructions == 2 && lackey_stats.skipped == 1;
+        bool champsim_ok = collect(CHAMPSIM_TRACE, champsim_path, champsim, champsim_stats) &&
+                           champsim == Accesses{{0x1000, read_ACCESS}, {0x2000, read_ACCESS}, {0x3000, WRITE_ACCESS}} &&
+                           champsim_stats.instructions == 2;
+
+        // Conversion to the native format preserves the access stream
+        ImportStats convert_stats;
+        TraceReader reader;
+        unsigned long long addrs[8];
+        unsigned char writes[8];
+        bool convert_ok = convertTrace(LACKEY_TRACE, lackey_path, native_path, convert_stats) &&
+                          reader.open(native_path) && reader.next(addrs, writes, 8) == 4 &&
+                          addrs[3] == 0x0025747c && writes[3] == 1 && writes[2] == 0;
+
+        remove(din_path.c_str());
+        remove(lackey_path.c_str());
+        remove(champsim_path.c_str());
+        remove(native_path.c_str());
+
+        bool result = din_ok && lackey_ok && champsim_ok && convert_ok;
+        if (!result) {
+            cout << "    ⚠ Dinero: " << din_ok << ", Lackey: " << lackey_ok
+                 << ", ChampSim: " << champsim_ok << ", Convert: " << convert_ok << "\n";
+        }
+        return result;
+    }
+
     bool testSequentialHitRates() {
         TwoLevelCache tlc(64);
 
@@ -696,16 +3185,238 @@ private:
     }
 };
 
-int main() {
-    CacheSimulator sim;
+// Parse a --seed value (decimal, 0x hex or 0 octal); false unless it starts
+// with a digit and is in range with no trailing characters
+bool parseSeed(const char *text, unsigned long long& seed) {
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long v = strtoull(text, &end, 0);
+    if (!isdigit((unsigned char)*text) || *end != '\0' || errno == ERANGE) return false;
+    seed = v;
+    return true;
+}
+
+void printUsage(const char *prog) {
+    cout << "Usage: " << prog << " [--seed N] [--config FILE] [--set K=V]... [--pipelined | --processes N | --ooo | --ifetch MB | --traffic |\n"
+         << "       " << string(strlen(prog), ' ') << " --sampled [--sample-error E] | --energy | --energy-table FILE] [--zipf-sweep]\n"
+         << "       " << prog << " [--seed N] [--config FILE] [--set K=V]... --replicates K [--ci-width X] [--threads N]\n"
+         << "       " << prog << " [--seed N] [--config FILE] [--set K=V]... --dse [--range K=V,..]... [--workload W] [--threads N]\n"
+         << "       " << prog << " [--seed N] [--config FILE] [--set K=V]... --trace FILE [--format F] [--shards N | --events W | --pipelined] [--convert OUT]\n"
+         << "       " << prog << " [--seed N] --test | --perf-check GOLDEN [--perf-scale X]\n"
+         << "Each line runs one mode; giving two modes is an error.\n"
+         << "  --seed N       master seed for all random streams (default: current time)\n"
+         << "  --pipelined    generate addresses on a producer thread feeding the simulator\n"
+         << "  --ooo          run the grid on the out-of-order core model and print MLP histograms\n"
+         << "  --traffic      report bytes per instruction across L1-L2 and L2-DRAM, tag storage, and\n"
+         << "                 the utilization of links given l2_bandwidth / dram_bandwidth\n"
+         << "  --sampled      estimate the grid's CPI from SMARTS-style samples of the stream\n"
+         << "  --sample-error E target relative 95% CI half-width for --sampled (default 0.03)\n"
+         << "  --energy       report energy per instruction and energy-delay product next to CPI\n"
+
+         << "  --energy-table F per-geometry cache and DRAM energies for --energy (implies it)\n"
+         << "  --ifetch MB    add an instruction-fetch stream over MB of code (L1I + shared L2)\n"
+         << "  --zipf-sweep   also report CPI and hit rates for a Zipf theta sweep over 64GB\n"
+         << "  --trace FILE   replay a trace file instead of the generator grid\n"
+         << "  --format F     trace format: native (default), din, lackey or champsim\n"
+         << "  --shards N     replay the trace on N set-sharded worker threads\n"
+         << "  --events W     replay the trace event-driven with up to W accesses outstanding\n"
+         << "  --convert OUT  convert the trace to the native format instead of replaying it\n"
+         << "  --test         run the test suite only; exit status 1 if any test fails\n"
+         << "  --perf-check G compare fixed-seed CPIs and engine speeds with the golden file G\n"
+         << "  --perf-scale X multiply the golden minimum rates by X (0 skips them)\n"
+         << "  --config FILE  read hierarchy parameters (\"key = value\" lines)\n"
+         << "  --processes N  compute the grid in N forked worker processes\n"
+         << "  --replicates K run up to K seeds per grid point and report mean, stddev and 95% CI\n"
+         << "  --ci-width X   stop adding replicates once the 95% CI half-width is <= X (CPI)\n"
+         << "  --dse          explore a design space (successive halving, Pareto output)\n"
+         << "  --range K=V,.. value list for one DSE parameter (config keys or l1_line)\n"
+         << "  --workload W   DSE workload by name (default memGen2)\n"
+         << "  --threads N    worker threads for --replicates and --dse (default: hardware threads)\n"
+         << "  --set K=V      override one parameter: l1_size, l1_assoc, l1_hit_time, l2_size,\n"
+         << "                 l2_line_size, l2_assoc, l2_hit_time, dram_penalty, iterations, mem_ratio,\n"
+         << "                 rob_size, issue_width, lsq_size, load_dependency, l1i_size, l1i_assoc,\n"
+         << "                 l1_sector_size, l2_sector_size, clock_ghz, l2_bandwidth, dram_bandwidth,\n"
+         << "                 warmup\n";
+}
+
+int main(int argc, char **argv) {
+    unsigned long long seed = time_seed();
+    bool zipf_sweep = false;
+    bool pipelined = false;
+    string trace_path, convert_path;
+    TraceFormat trace_format = NATIVE_TRACE;
+    HierarchyConfig config;
+    string config_error;
+    bool dse = false;
+    DesignSpace space;
+    string dse_workload = "memGen2";
+    ReplicateConfig replicates;
+    int shards = 0;  // 0: --shards not given
+    int processes = 0;
+    int event_window = 0;
+    bool ooo = false;
+    unsigned long long code_footprint = 0;
+    bool tests_only = false;
+    bool traffic = false;
+    bool sampled = false;
+    double sample_error = SamplingConfig().target_error;
+    bool energy = false;
+    EnergyModel energy_model;
+    string perf_golden;
+    double perf_scale = 1.0;
+    int threads = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--zipf-sweep") {
+            zipf_sweep = true;
+        } else if (arg == "--pipelined") {
+            pipelined = true;
+        } else if (arg == "--ooo") {
+            ooo = true;
+        } else if (arg == "--traffic") {
+            traffic = true;
+        } else if (arg == "--sampled") {
+            sampled = true;
+        } else if (arg == "--sample-error" && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            sample_error = atof(argv[++i]);
+        } else if (arg == "--energy") {
+            energy = true;
+        } else if (arg == "--energy-table" && i + 1 < argc) {
+            energy = true;
+            if (!energy_model.load(argv[++i], config_error)) break;
+        } else if (arg == "--test") {
+            tests_only = true;
+        } else if (arg == "--perf-check" && i + 1 < argc) {
+            perf_golden = argv[++i];
+        } else if (arg == "--perf-scale" && i + 1 < argc && atof(argv[i + 1]) >= 0) {
+            perf_scale = atof(argv[++i]);
+        } else if (arg == "--ifetch" && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            code_footprint = (unsigned long long)(atof(argv[++i]) * (1 << 20));
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--convert" && i + 1 < argc) {
+            convert_path = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc && parseTraceFormat(argv[i + 1], trace_format)) {
+            i++;
+        } else if (arg == "--replicates" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            replicates.max_replicates = atoi(argv[++i]);
+        } else if (arg == "--ci-width" && i + 1 < argc && atof(argv[i + 1]) > 0) {
+            replicates.target_half_width = atof(argv[++i]);
+        } else if (arg == "--processes" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            processes = atoi(argv[++i]);
+        } else if (arg == "--shards" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            shards = atoi(argv[++i]);
+        } else if (arg == "--events" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            event_window = atoi(argv[++i]);
+        } else if (arg == "--dse") {
+            dse = true;
+        } else if (arg == "--range" && i + 1 < argc && space.setRange(argv[i + 1])) {
+            i++;
+        } else if (arg == "--workload" && i + 1 < argc) {
+            dse_workload = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--config" && i + 1 < argc) {
+            if (!config.load(argv[++i], config_error)) break;
+        } else if (arg == "--set" && i + 1 < argc) {
+            if (!config.set(argv[++i])) {
+                config_error = string("bad setting '") + argv[i] + "'";
+                break;
+            }
+        } else if (arg == "--seed" && i + 1 < argc) {
+            if (!parseSeed(argv[++i], seed)) {
+                cout << "Invalid seed '" << argv[i] << "'\n";
+                return 1;
+            }
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            if (!parseSeed(arg.c_str() + 7, seed)) {
+                cout << "Invalid seed '" << arg.substr(7) << "'\n";
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if (config_error.empty()) config.validate({16, 32, 64, 128}, config_error);
+    if (!config_error.empty()) {
+        cout << "Invalid configuration: " << config_error << "\n";
+        return 1;
+    }
+
+    // Run modes each replace the default grid; the dispatch below runs only
+    // one of them, so a second one is an error rather than silently dropped
+    vector<const char*> modes;
+    auto mode = [&](bool on, const char *flag) { if (on) modes.push_back(flag); };
+    mode(!trace_path.empty(), "--trace");
+    mode(dse, "--dse");
+    mode(pipelined && trace_path.empty(), "--pipelined");
+    mode(ooo, "--ooo");
+    mode(traffic, "--traffic");
+    mode(sampled, "--sampled");
+    mode(energy, "--energy");
+    mode(code_footprint > 0, "--ifetch");
+    mode(replicates.max_replicates > 1, "--replicates");
+    mode(processes > 0, "--processes");
+    if (modes.size() > 1) {
+        cout << modes[0] << " cannot be combined with " << modes[1] << "\n";
+        return 1;
+    }
+    if ((shards > 0 || event_window > 0) && trace_path.empty()) {
+        cout << (shards > 0 ? "--shards" : "--events") << " needs --trace\n";
+        return 1;
+    }
+
+    CacheSimulator sim(seed);
+    sim.setPipelined(pipelined);
+    sim.setConfig(config);
+    sim.setShards(shards);
+    sim.setEventWindow(event_window);
+    sim.setEnergyModel(energy_model);
+    if (!convert_path.empty()) {
+        ImportStats stats;
+        if (trace_path.empty() || trace_format == NATIVE_TRACE ||
+            !convertTrace(trace_format, trace_path, convert_path, stats)) {
+            cout << "Cannot convert " << trace_path << " (use --trace FILE with --format din|lackey|champsim)\n";
+            return 1;
+        }
+        cout << "Converted " << stats.reads + stats.writes << " accesses (" << stats.reads << " reads, "
+             << stats.writes << " writes, " << stats.instructions << " instructions, " << stats.skipped
+             << " lines skipped) to " << convert_path << "\n";
+        return 0;
+    }
+    if (!trace_path.empty()) return sim.runTrace(trace_path, trace_format) ? 0 : 1;
+    if (dse) {
+        auto workloads = sim.defaultWorkloads();
+        int w = 0;
+        while (w < (int)workloads.size() && workloads[w]->name() != dse_workload) w++;
+        if (w == (int)workloads.size()) {
+            cout << "Unknown workload " << dse_workload << "\n";
+            return 1;
+        }
+        sim.runDesignSpaceExploration(space.empty() ? DesignSpace::defaults() : space, w, threads);
+        return 0;
+    }
+
+    if (!perf_golden.empty()) return sim.runPerfCheck(perf_golden, perf_scale) ? 0 : 1;
 
-    cout << "Starting Cache Simulator Tests and Analysis...\n";
+    if (tests_only) return sim.runComprehensiveTests() ? 0 : 1;
 
-    // Run comprehensive tests first
-    sim.runComprehensiveTests();
+    cout << "Starting Cache Simulator Analysis...\n";
 
     // Run main simulations
-    sim.runSimulations();
+    if (ooo) sim.runCoreSimulations();
+    else if (traffic) sim.runTrafficSimulations();
+    else if (sampled) {
+        if (!sim.runSampledSimulations(sample_error)) return 1;
+    }
+    else if (energy) sim.runEnergySimulations();
+    else if (code_footprint > 0) sim.runFetchSimulations(code_footprint);
+    else if (replicates.max_replicates > 1) sim.runReplicatedSimulations(replicates, threads);
+    else if (processes > 0 && !sim.runForkedSimulations(processes)) return 1;
+    else if (processes == 0) sim.runSimulations();
+    if (zipf_sweep) sim.runZipfSweep();
 
     return 0;
 }
\ No newline at end of file